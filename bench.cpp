@@ -0,0 +1,519 @@
+#define NXML_IMPL
+#include "nxml.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <new>
+
+#ifdef _WIN32
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+using namespace std;
+
+// Every allocation made through global new is counted, so each benchmark can report allocations per iteration
+static atomic<uint64_t> s_AllocationCount{ 0 };
+static atomic<uint64_t> s_AllocationBytes{ 0 };
+
+void* operator new(size_t size)
+{
+    s_AllocationCount.fetch_add(1, memory_order_relaxed);
+    s_AllocationBytes.fetch_add(size, memory_order_relaxed);
+    if (void* p = malloc(size ? size : 1)) return p;
+    throw bad_alloc();
+}
+
+void* operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+// every form of delete goes through the one that frees, mirroring how new[] goes through new. That one stays out of
+// line, inlined into a caller GCC sees free() on a pointer from operator new and warns about a mismatched pair
+#ifdef _MSC_VER
+#define BENCH_NOINLINE __declspec(noinline)
+#else
+#define BENCH_NOINLINE __attribute__((noinline))
+#endif
+
+BENCH_NOINLINE void operator delete(void* p) noexcept
+{
+    free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+    operator delete(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+    operator delete(p);
+}
+
+void operator delete[](void* p, size_t) noexcept
+{
+    operator delete(p);
+}
+
+// High-water RSS of the whole run, never reset
+static uint64_t ProcessPeakRssKb()
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return counters.PeakWorkingSetSize / 1024;
+    return 0;
+#else
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return static_cast<uint64_t>(usage.ru_maxrss) / 1024;
+#else
+    return static_cast<uint64_t>(usage.ru_maxrss);
+#endif
+#endif
+}
+
+// Starts a new peak RSS window, false where the peak can only grow for the life of the process
+static bool ResetPeakRss()
+{
+#ifdef __linux__
+    // "5" resets VmHWM to the current RSS
+    FILE* file = fopen("/proc/self/clear_refs", "w");
+    if (file == nullptr) return false;
+    bool written = fputs("5", file) >= 0;
+    return fclose(file) == 0 && written;
+#else
+    return false;
+#endif
+}
+
+// High-water RSS since the last ResetPeakRss, the process peak where there is no window
+static uint64_t PeakRssKb()
+{
+#ifdef __linux__
+    if (FILE* file = fopen("/proc/self/status", "r"))
+    {
+        char line[256];
+        unsigned long long kb = 0;
+        bool found = false;
+        while (!found && fgets(line, sizeof(line), file) != nullptr)
+        {
+            found = sscanf(line, "VmHWM: %llu kB", &kb) == 1;
+        }
+        fclose(file);
+        if (found) return kb;
+    }
+#endif
+    return ProcessPeakRssKb();
+}
+
+/// <summary>
+/// Synthetic input, either one document or a batch of small independent messages
+/// </summary>
+struct Corpus
+{
+    string          Name;
+    string          Xml;
+    vector<string>  Messages;
+    // path whose matches the lookup benchmark selects
+    string          LookupQuery;
+    size_t          Elements = 0;
+
+    size_t Bytes() const
+    {
+        size_t bytes = Xml.size();
+        for (const string& message : Messages) bytes += message.size();
+        return bytes;
+    }
+};
+
+static size_t CountElements(const string& xml)
+{
+    size_t count = 0;
+    for (size_t i = 0; i + 1 < xml.size(); i++)
+    {
+        if (xml[i] == '<' && xml[i + 1] != '/' && xml[i + 1] != '?' && xml[i + 1] != '!') count++;
+    }
+    return count;
+}
+
+static string Filler(size_t length, uint32_t seed)
+{
+    static const char* words[] = { "lorem", "ipsum", "dolor", "sit", "amet", "consectetur", "adipiscing", "elit", "sed", "do", "eiusmod", "tempor" };
+    string text;
+    while (text.size() < length)
+    {
+        seed = seed * 1664525u + 1013904223u;
+        if (!text.empty()) text += ' ';
+        text += words[(seed >> 16) % 12];
+    }
+    return text;
+}
+
+// catalog/book records shaped like sample.xml
+static Corpus MakeWide(size_t targetBytes)
+{
+    Corpus corpus;
+    corpus.Name = "wide";
+    corpus.Xml = "<?xml version=\"1.0\"?>\n<catalog>\n";
+    for (uint32_t i = 0; corpus.Xml.size() < targetBytes; i++)
+    {
+        corpus.Xml += "   <book id=\"bk" + to_string(i) + "\">\n"
+            "      <author>" + Filler(16, i) + "</author>\n"
+            "      <title>" + Filler(24, i + 1) + "</title>\n"
+            "      <genre>Fantasy</genre>\n"
+            "      <price>" + to_string(i % 50) + "." + to_string(10 + i % 90) + "</price>\n"
+            "      <publish_date>2000-" + (i % 12 < 9 ? "0" : "") + to_string(i % 12 + 1) + "-15</publish_date>\n"
+            "      <description>" + Filler(120, i + 2) + "</description>\n"
+            "   </book>\n";
+    }
+    corpus.Xml += "</catalog>\n";
+    corpus.LookupQuery = "catalog/book[@id='bk7']/price";
+    return corpus;
+}
+
+// chains of nested elements, depth levels each
+static Corpus MakeDeep(size_t targetBytes, size_t depth)
+{
+    Corpus corpus;
+    corpus.Name = "deep";
+    corpus.Xml = "<?xml version=\"1.0\"?>\n<root>";
+    while (corpus.Xml.size() < targetBytes)
+    {
+        for (size_t d = 0; d < depth; d++) corpus.Xml += "<node level=\"" + to_string(d) + "\">";
+        corpus.Xml += "<leaf>value</leaf>";
+        for (size_t d = 0; d < depth; d++) corpus.Xml += "</node>";
+    }
+    corpus.Xml += "</root>";
+    corpus.LookupQuery = "//leaf";
+    return corpus;
+}
+
+// elements carrying many attributes and no text
+static Corpus MakeAttributes(size_t targetBytes, size_t attributeCount)
+{
+    Corpus corpus;
+    corpus.Name = "attributes";
+    corpus.Xml = "<?xml version=\"1.0\"?>\n<items>\n";
+    for (uint32_t i = 0; corpus.Xml.size() < targetBytes; i++)
+    {
+        corpus.Xml += "<item id=\"" + to_string(i) + "\"";
+        for (size_t a = 0; a < attributeCount; a++) corpus.Xml += " attr" + to_string(a) + "=\"" + Filler(8, i + a) + "\"";
+        corpus.Xml += "></item>\n";
+    }
+    corpus.Xml += "</items>\n";
+    corpus.LookupQuery = "items/item[@id='42']";
+    return corpus;
+}
+
+// few elements, long text runs
+static Corpus MakeText(size_t targetBytes, size_t paragraphBytes)
+{
+    Corpus corpus;
+    corpus.Name = "text";
+    corpus.Xml = "<?xml version=\"1.0\"?>\n<document>\n";
+    for (uint32_t i = 0; corpus.Xml.size() < targetBytes; i++)
+    {
+        corpus.Xml += "<para>" + Filler(paragraphBytes, i) + "</para>\n";
+    }
+    corpus.Xml += "</document>\n";
+    corpus.LookupQuery = "document/para[3]";
+    return corpus;
+}
+
+// a batch of small independent documents, as seen by a message handler
+static Corpus MakeMessages(size_t targetBytes)
+{
+    Corpus corpus;
+    corpus.Name = "messages";
+    size_t bytes = 0;
+    for (uint32_t i = 0; bytes < targetBytes; i++)
+    {
+        string message = "<?xml version=\"1.0\"?>\n<order id=\"" + to_string(i) + "\"><customer>" + Filler(12, i) +
+            "</customer><sku>SKU-" + to_string(i % 997) + "</sku><quantity>" + to_string(i % 9 + 1) + "</quantity><price>" + to_string(i % 100) + ".99</price></order>";
+        bytes += message.size();
+        corpus.Messages.push_back(std::move(message));
+    }
+    corpus.LookupQuery = "order/price";
+    return corpus;
+}
+
+struct Result
+{
+    string      Corpus;
+    string      Operation;
+    size_t      Bytes = 0;
+    size_t      Elements = 0;
+    size_t      Iterations = 0;
+    double      BestSeconds = 0.0;
+    double      MeanSeconds = 0.0;
+    uint64_t    Allocations = 0;
+    uint64_t    AllocatedBytes = 0;
+    // high-water RSS over this operation's runs, or over the process so far when PeakRssIsPerOperation is false
+    uint64_t    PeakRssKb = 0;
+    bool        PeakRssIsPerOperation = false;
+};
+
+/// <summary>
+/// Runs body iterations times after one warm-up run, keeping the best and mean wall time
+/// and the allocations of a single run. Peak RSS covers the warm-up and measured runs.
+/// </summary>
+template <typename F>
+static Result Measure(const Corpus& corpus, const char* operation, size_t bytes, size_t elements, size_t iterations, F&& body)
+{
+    Result result{ corpus.Name, operation, bytes, elements, iterations };
+    result.PeakRssIsPerOperation = ResetPeakRss();
+
+    body();
+
+    result.BestSeconds = 1e300;
+    double total = 0.0;
+
+    for (size_t i = 0; i < iterations; i++)
+    {
+        uint64_t count = s_AllocationCount.load();
+        uint64_t allocated = s_AllocationBytes.load();
+
+        auto start = chrono::steady_clock::now();
+        body();
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+        result.Allocations = s_AllocationCount.load() - count;
+        result.AllocatedBytes = s_AllocationBytes.load() - allocated;
+        result.BestSeconds = min(result.BestSeconds, seconds);
+        total += seconds;
+    }
+    result.MeanSeconds = total / static_cast<double>(iterations);
+    result.PeakRssKb = PeakRssKb();
+    return result;
+}
+
+static void RunCorpus(Corpus& corpus, size_t iterations, vector<Result>& results)
+{
+    corpus.Elements = CountElements(corpus.Xml);
+    for (const string& message : corpus.Messages) corpus.Elements += CountElements(message);
+
+    nxml::Query query(corpus.LookupQuery);
+    size_t sink = 0;
+
+    if (corpus.Messages.empty())
+    {
+        results.push_back(Measure(corpus, "parse", corpus.Bytes(), corpus.Elements, iterations, [&]
+        {
+            nxml::Document doc = nxml::ParseString(corpus.Xml);
+            sink += doc.RootElements.size();
+        }));
+
+        results.push_back(Measure(corpus, "parse_view", corpus.Bytes(), corpus.Elements, iterations, [&]
+        {
+            nxml::DocumentView doc = nxml::ParseView(string_view(corpus.Xml));
+            sink += doc.NodeCount();
+        }));
+
+        results.push_back(Measure(corpus, "parse_lazy", corpus.Bytes(), corpus.Elements, iterations, [&]
+        {
+            nxml::LazyDocument doc = nxml::ParseLazy(string_view(corpus.Xml));
+            sink += doc.IndexedCount();
+        }));
+
+        nxml::Document doc = nxml::ParseString(corpus.Xml);
+        string serialized = doc.ToString();
+        results.push_back(Measure(corpus, "to_string", serialized.size(), corpus.Elements, iterations, [&]
+        {
+            sink += doc.ToString().size();
+        }));
+
+        // lookups are counted as elements per second, one element per query run
+        const size_t lookups = 1000;
+        results.push_back(Measure(corpus, "lookup", 0, lookups, iterations, [&]
+        {
+            vector<nxml::Element*> matches;
+            for (size_t i = 0; i < lookups; i++)
+            {
+                matches.clear();
+                query.Select(doc, matches);
+                sink += matches.size();
+            }
+        }));
+    }
+    else
+    {
+        results.push_back(Measure(corpus, "parse", corpus.Bytes(), corpus.Elements, iterations, [&]
+        {
+            for (string& message : corpus.Messages)
+            {
+                nxml::Document doc = nxml::ParseString(message);
+                sink += doc.RootElements.size();
+            }
+        }));
+
+        results.push_back(Measure(corpus, "parse_view", corpus.Bytes(), corpus.Elements, iterations, [&]
+        {
+            for (const string& message : corpus.Messages)
+            {
+                nxml::DocumentView doc = nxml::ParseView(string_view(message));
+                sink += doc.NodeCount();
+            }
+        }));
+
+        results.push_back(Measure(corpus, "parse_lazy", corpus.Bytes(), corpus.Elements, iterations, [&]
+        {
+            for (const string& message : corpus.Messages)
+            {
+                nxml::LazyDocument doc = nxml::ParseLazy(string_view(message));
+                sink += doc.IndexedCount();
+            }
+        }));
+
+        // one document recycled across messages, the steady state of a message loop
+        nxml::Document reused;
+        results.push_back(Measure(corpus, "parse_reuse", corpus.Bytes(), corpus.Elements, iterations, [&]
+        {
+            for (const string& message : corpus.Messages)
+            {
+                nxml::ParseString(string_view(message), reused);
+                sink += reused.RootElements.size();
+            }
+        }));
+
+        vector<nxml::Document> docs;
+        for (string& message : corpus.Messages) docs.push_back(nxml::ParseString(message));
+        results.push_back(Measure(corpus, "to_string", corpus.Bytes(), corpus.Elements, iterations, [&]
+        {
+            for (nxml::Document& doc : docs) sink += doc.ToString().size();
+        }));
+
+        results.push_back(Measure(corpus, "lookup", 0, docs.size(), iterations, [&]
+        {
+            vector<nxml::Element*> matches;
+            for (nxml::Document& doc : docs)
+            {
+                matches.clear();
+                query.Select(doc, matches);
+                sink += matches.size();
+            }
+        }));
+    }
+
+    // keeps the optimiser from discarding the measured work
+    if (sink == 0) fprintf(stderr, "no work done for %s\n", corpus.Name.c_str());
+}
+
+static void AppendJsonString(string& out, const string& value)
+{
+    out += '"';
+    for (char c : value)
+    {
+        if (c == '"' || c == '\\') out += '\\';
+        out += c;
+    }
+    out += '"';
+}
+
+static string ToJson(const vector<Result>& results, size_t sizeBytes, size_t iterations)
+{
+    static const char* levels[] = { "scalar", "sse2", "avx2" };
+
+    string out = "{\n  \"simd\": \"";
+    out += levels[static_cast<int>(nxml::simd::GetLevel())];
+    out += "\",\n  \"corpus_bytes\": " + to_string(sizeBytes) + ",\n  \"iterations\": " + to_string(iterations);
+    out += ",\n  \"peak_rss_kb\": " + to_string(PeakRssKb()) + ",\n  \"results\": [\n";
+
+    char buffer[512];
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        const Result& r = results[i];
+        double mbPerSecond = r.Bytes / r.BestSeconds / (1024.0 * 1024.0);
+        double elementsPerSecond = r.Elements / r.BestSeconds;
+
+        out += "    {\"corpus\": ";
+        AppendJsonString(out, r.Corpus);
+        out += ", \"operation\": ";
+        AppendJsonString(out, r.Operation);
+        snprintf(buffer, sizeof(buffer),
+            ", \"bytes\": %zu, \"elements\": %zu, \"iterations\": %zu, \"best_seconds\": %.6f, \"mean_seconds\": %.6f"
+            ", \"mb_per_s\": %.2f, \"elements_per_s\": %.0f, \"allocations\": %llu, \"allocated_bytes\": %llu"
+            ", \"peak_rss_kb\": %llu, \"peak_rss_per_operation\": %s}",
+            r.Bytes, r.Elements, r.Iterations, r.BestSeconds, r.MeanSeconds, mbPerSecond, elementsPerSecond,
+            static_cast<unsigned long long>(r.Allocations), static_cast<unsigned long long>(r.AllocatedBytes),
+            static_cast<unsigned long long>(r.PeakRssKb), r.PeakRssIsPerOperation ? "true" : "false");
+        out += buffer;
+        out += i + 1 < results.size() ? ",\n" : "\n";
+    }
+    out += "  ]\n}\n";
+    return out;
+}
+
+static void PrintUsage()
+{
+    fprintf(stderr,
+        "usage: nxml-bench [--size MB] [--iterations N] [--corpus wide|deep|attributes|text|messages] [--output file]\n"
+        "  --size        approximate bytes per corpus in MB (default 4)\n"
+        "  --iterations  measured runs per operation after one warm-up (default 5)\n"
+        "  --corpus      run only the named corpus, may be repeated (default all)\n"
+        "  --output      write the JSON report to file instead of stdout\n");
+}
+
+int main(int argc, char** argv)
+{
+    double sizeMb = 4.0;
+    size_t iterations = 5;
+    vector<string> selected;
+    const char* outputPath = nullptr;
+
+    for (int i = 1; i < argc; i++)
+    {
+        string arg = argv[i];
+        if (arg == "--size" && i + 1 < argc) sizeMb = atof(argv[++i]);
+        else if (arg == "--iterations" && i + 1 < argc) iterations = static_cast<size_t>(atoi(argv[++i]));
+        else if (arg == "--corpus" && i + 1 < argc) selected.push_back(argv[++i]);
+        else if (arg == "--output" && i + 1 < argc) outputPath = argv[++i];
+        else
+        {
+            PrintUsage();
+            return 1;
+        }
+    }
+    if (iterations == 0 || sizeMb <= 0.0)
+    {
+        PrintUsage();
+        return 1;
+    }
+
+    size_t bytes = static_cast<size_t>(sizeMb * 1024 * 1024);
+    auto wanted = [&](const char* name) { return selected.empty() || find(selected.begin(), selected.end(), name) != selected.end(); };
+
+    vector<Result> results;
+    auto run = [&](Corpus corpus)
+    {
+        fprintf(stderr, "running %s (%zu bytes)\n", corpus.Name.c_str(), corpus.Bytes());
+        RunCorpus(corpus, iterations, results);
+    };
+
+    if (wanted("wide")) run(MakeWide(bytes));
+    if (wanted("deep")) run(MakeDeep(bytes, 64));
+    if (wanted("attributes")) run(MakeAttributes(bytes, 16));
+    if (wanted("text")) run(MakeText(bytes, 4096));
+    if (wanted("messages")) run(MakeMessages(bytes));
+
+    string json = ToJson(results, bytes, iterations);
+    if (outputPath != nullptr)
+    {
+        FILE* file = fopen(outputPath, "wb");
+        if (file == nullptr)
+        {
+            fprintf(stderr, "could not open %s\n", outputPath);
+            return 1;
+        }
+        fwrite(json.data(), 1, json.size(), file);
+        fclose(file);
+    }
+    else
+    {
+        fwrite(json.data(), 1, json.size(), stdout);
+    }
+    return 0;
+}
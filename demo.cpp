@@ -7,6 +7,7 @@ struct Vec2
     double X;
     double Y;
 };
+NXML_DEFINE_TYPE(Vec2, X, Y)
 
 struct TestStruct
 {
@@ -14,12 +15,8 @@ struct TestStruct
     float  SomeFloat;
     double SomeDouble;
     Vec2   SomeUserType;
-
-    operator nxml::Element& () { return nxml::Element::Invalid; }
-    operator nxml::Element () const { return nxml::Element::Invalid; }
-
-
 };
+NXML_DEFINE_TYPE(TestStruct, Name, SomeFloat, SomeDouble, SomeUserType)
 
 int main() {
     // Simple
@@ -34,5 +31,9 @@ int main() {
     Vec2 v{ 1.0, 2.0 };
     TestStruct userData{ "Hello", 1.5f, 3.0, v };
 
-    nxml::Element userDataElement = userData;
-}
\ No newline at end of file
+    nxml::Element userDataElement = nxml::ToElement(userData, "TestStruct");
+
+    // straight from parser events into the struct, no Element tree in between
+    TestStruct loadedData{};
+    nxml::ParseInto(userDataElement.ToString(), loadedData);
+}
@@ -1,7 +1,31 @@
 #pragma once
 #include <string>
+#include <string_view>
 #include <vector>
 #include <stack>
+#include <deque>
+#include <memory>
+#include <memory_resource>
+#include <cstdint>
+#include <chrono>
+#include <charconv>
+#include <type_traits>
+#include <tuple>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#include <cstring>
+#include <cstdio>
+#include <cerrno>
+#include <thread>
+#include <mutex>
+#include <shared_mutex>
+#include <atomic>
+#include <filesystem>
+#include <unordered_map>
+#include <condition_variable>
+#include <functional>
+#include <future>
 #include <iostream>
 #include <sstream>
 #include <fstream>
@@ -12,6 +36,16 @@
 #include <algorithm>
 #include <cctype>
 #include <regex>
+#if NXML_ZLIB
+#include <zlib.h>
+#endif
+#if NXML_ZSTD
+#include <zstd.h>
+#endif
+
+#if !defined(NXML_NO_SIMD) && (defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86))
+#define NXML_SIMD_X86
+#endif
 
 namespace nxml
 {
@@ -24,7 +58,9 @@ namespace nxml
     {
         Integer,
         Float,
-        String
+        String,
+        Boolean,
+        Date
     };
 
     /// <summary>
@@ -37,6 +73,67 @@ namespace nxml
         virtual string  ToString() = 0;
         virtual void    FromString(string str) = 0;
     };
+    /// <summary>
+    /// Calendar date in the xs:date form YYYY-MM-DD with an optional Z or +hh:mm zone
+    /// </summary>
+    struct Date
+    {
+        int     Year = 0;
+        int     Month = 0;
+        int     Day = 0;
+        bool    HasZone = false;
+        int     ZoneOffsetMinutes = 0;
+
+        static bool Parse(string_view text, Date& out);
+        string      ToString() const;
+
+        bool operator==(const Date& other) const { return Year == other.Year && Month == other.Month && Day == other.Day && HasZone == other.HasZone && ZoneOffsetMinutes == other.ZoneOffsetMinutes; }
+        bool operator!=(const Date& other) const { return !(*this == other); }
+        // orders by the written fields, zone included, so it agrees with operator== and dates that differ only by zone stay distinct in ordered containers
+        bool operator<(const Date& other) const
+        {
+            return std::tie(Year, Month, Day, HasZone, ZoneOffsetMinutes) < std::tie(other.Year, other.Month, other.Day, other.HasZone, other.ZoneOffsetMinutes);
+        }
+    };
+
+    // types stored as element text rather than as child elements
+    template <typename T>
+    struct IsValueType : std::integral_constant<bool, std::is_arithmetic<T>::value || std::is_same<T, string>::value || std::is_same<T, Date>::value> {};
+
+    static string_view TrimValue(string_view text);
+    // drops the '+' XML allows in front of a number, which from_chars rejects. Only when digits (or '.' for fraction) follow,
+    // so "+-5" stays invalid
+    static string_view StripPlusSign(string_view text, bool fraction);
+
+    // locale independent conversions between text and values, surrounding whitespace is ignored when reading.
+    // False when text is not a valid value, out keeps what it held then
+    static bool ReadValue(string_view text, string& out) { out.assign(text.data(), text.size()); return true; }
+    static bool ReadValue(string_view text, bool& out);
+    static bool ReadValue(string_view text, Date& out);
+
+    template <typename T>
+    static typename std::enable_if<std::is_arithmetic<T>::value, bool>::type ReadValue(string_view text, T& out)
+    {
+        text = StripPlusSign(TrimValue(text), std::is_floating_point<T>::value);
+        T value{};
+        auto result = std::from_chars(text.data(), text.data() + text.size(), value);
+        if (text.empty() || result.ec != std::errc() || result.ptr != text.data() + text.size()) return false;
+        out = value;
+        return true;
+    }
+
+    static void WriteValue(string& out, const string& value) { out = value; }
+    static void WriteValue(string& out, bool value) { out = value ? "true" : "false"; }
+    static void WriteValue(string& out, const Date& value);
+
+    template <typename T>
+    static typename std::enable_if<std::is_arithmetic<T>::value>::type WriteValue(string& out, T value)
+    {
+        char buffer[64];
+        auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+        out.assign(buffer, result.ptr);
+    }
+
     /// <sumarry>
     /// Element attribute stuct
     /// </summary>
@@ -45,16 +142,44 @@ namespace nxml
         string Key;
         string SerializedValue;
 
+        // decoded SerializedValue, or fallback when it does not hold a value of that type
+        int64_t AsInt(int64_t fallback = 0) const;
+        double  AsDouble(double fallback = 0.0) const;
+        bool    AsBool(bool fallback = false) const;
+        Date    AsDate() const;
+
+        void    SetInt(int64_t value) { WriteValue(SerializedValue, value); }
+        void    SetDouble(double value) { WriteValue(SerializedValue, value); }
+        void    SetBool(bool value) { WriteValue(SerializedValue, value); }
+        void    SetDate(const Date& value) { WriteValue(SerializedValue, value); }
+
         virtual string  ToString()      override {return "<?xml version=\"1.0\"?>";}
         virtual void    FromString(string str)    override {}
+
+        // declared so the virtual destructor does not turn every move into a string copy
+        Attribute() = default;
+        Attribute(const Attribute&) = default;
+        Attribute(Attribute&&) = default;
+        Attribute& operator=(const Attribute&) = default;
+        Attribute& operator=(Attribute&&) = default;
         
         virtual ~Attribute() {};
     };
 
+    /// <summary>
+    /// Attribute carrying its decoded value. SerializedValue is kept in step with Value,
+    /// so storing one in a vector<Attribute> loses nothing, and reading it back decodes it again.
+    /// </summary>
     template <typename T>
     struct TAttribute : Attribute
     {
-        T Value;
+        T Value{};
+
+        TAttribute() = default;
+        TAttribute(string key, const T& value) { Key = std::move(key); Set(value); }
+        explicit TAttribute(const Attribute& attribute) : Attribute(attribute) { ReadValue(SerializedValue, Value); }
+
+        void Set(const T& value) { Value = value; WriteValue(SerializedValue, value); }
     };
 
 
@@ -102,598 +227,8085 @@ namespace nxml
         Element&    operator[](const char* key);
         Element&    operator[](const ElementWithAttribute& search);
 
+        // decoded InnerValue, or fallback when it does not hold a value of that type
+        int64_t     AsInt(int64_t fallback = 0) const;
+        double      AsDouble(double fallback = 0.0) const;
+        bool        AsBool(bool fallback = false) const;
+        Date        AsDate() const;
+
+        void        SetInt(int64_t value) { WriteValue(InnerValue, value); }
+        void        SetDouble(double value) { WriteValue(InnerValue, value); }
+        void        SetBool(bool value) { WriteValue(InnerValue, value); }
+        void        SetDate(const Date& value) { WriteValue(InnerValue, value); }
+
         virtual string  ToString()      override;
         virtual void    FromString(string str)    override {}
     };
 
     /// <summary>
-    /// Container for declaration and root element
+    /// Figures collected while parsing a document, only filled in when built with NXML_TRACE enabled
+    /// </summary>
+    struct ParseStats
+    {
+        // one slot per Parser::Mode
+        static constexpr size_t ModeCount = 10;
+
+        uint64_t    Bytes = 0;
+        uint64_t    Elements = 0;
+        uint64_t    Attributes = 0;
+        uint64_t    TextNodes = 0;
+        // subtrees passed over by a projected parse
+        uint64_t    SkippedElements = 0;
+        size_t      MaxDepth = 0;
+        double      Seconds = 0.0;
+
+        double      ModeSeconds[ModeCount] = {};
+        uint64_t    ModeSwitches[ModeCount] = {};
+
+        // upstream allocations made by a DocumentView's arena
+        uint64_t    Allocations = 0;
+        uint64_t    AllocatedBytes = 0;
+
+        string      ToString() const;
+    };
+
+    /// <summary>
+    /// Container for declaration and root element. Elements own their children and attributes by value, so building a
+    /// Document costs about one allocation per element and freeing it walks the whole tree. DocumentView holds the same
+    /// tree in a single arena and frees it in one release, use it where that cost matters. Parsing into a recycled
+    /// Document (ParseString(input, doc)) reuses the storage of the previous tree instead.
     /// </summary>
     struct Document : ISerializable
     {
         Declaration Decl;
         vector<Element> RootElements;
+        ParseStats Stats;
 
         Element& operator[](const char* key);
 
+        // writes a flat snapshot that LoadBinary reads back without parsing, source is the xml it was parsed from
+        bool            SaveBinary(const char* path, string_view source = string_view()) const;
+        // false for a missing, corrupt or older format snapshot, or with a source, one made from other xml than it
+        bool            LoadBinary(const char* path);
+        bool            LoadBinary(const char* path, string_view source);
+
         virtual string  ToString()      override;
         virtual void    FromString(string str)    override {}
+
+    protected:
+        bool            LoadSnapshot(const char* path, const string_view* source);
     };
 
-    class Parser
+    /// <summary>
+    /// Attribute whose key and value are slices of the parsed source buffer
+    /// </summary>
+    struct AttributeView
+    {
+        string_view Key;
+        string_view SerializedValue;
+
+        int64_t AsInt(int64_t fallback = 0) const;
+        double  AsDouble(double fallback = 0.0) const;
+        bool    AsBool(bool fallback = false) const;
+        Date    AsDate() const;
+    };
+
+    using Atom = uint32_t;
+
+    /// <summary>
+    /// Interns element and attribute names as small integer atoms so repeated names are stored once
+    /// and compared with a single integer compare. Interning is thread-safe, so one table can be shared
+    /// by every document parsed from the same vocabulary. Atoms never move once handed out,
+    /// resolving one back to its name takes no lock.
+    /// </summary>
+    class NameTable
     {
     public:
-        Parser();
-        Document GetFromString(string& xml);
-        string   ToString(Document& xml);
+        static constexpr Atom None = UINT32_MAX;
 
-        enum class Mode
+        NameTable() = default;
+        NameTable(const NameTable&) = delete;
+        NameTable& operator=(const NameTable&) = delete;
+
+        Atom        Intern(string_view name);
+        // None when the name has never been interned
+        Atom        Find(string_view name) const;
+        string_view Name(Atom atom) const
         {
-            Declaration,
-            WaitForElementOpen,
-            ElementOpen,
-            WaitForAttribute,
-            ElementAttributeName,
-            ElementAttributeValue,
-            ElementClose,
-            GetInnerElementType,
-            ElementValue,
-        };
+            uint32_t slot = atom + FirstChunkSize;
+            uint32_t chunk = HighestBit(slot) - FirstChunkBits;
+            return p_Chunks[chunk][slot - (FirstChunkSize << chunk)];
+        }
+        size_t      Size() const;
+
     protected:
-        Mode p_Mode;
+        // chunk n holds FirstChunkSize << n names, so small documents only pay for a small first chunk
+        static constexpr uint32_t FirstChunkBits = 5;
+        static constexpr uint32_t FirstChunkSize = uint32_t(1) << FirstChunkBits;
+        static constexpr size_t MaxChunks = 32 - FirstChunkBits;
 
-        stringstream p_ElementNameStream;
-        stringstream p_ElementValueStream;
-        stringstream p_AttributeNameStream;
-        stringstream p_AttributeValueStream;
+        // slots stay below 2^32, so the 32-bit scan is enough on every target
+        static uint32_t HighestBit(uint32_t value)
+        {
+#ifdef _MSC_VER
+            unsigned long index;
+            _BitScanReverse(&index, static_cast<unsigned long>(value));
+            return static_cast<uint32_t>(index);
+#else
+            return 31 - static_cast<uint32_t>(__builtin_clz(value));
+#endif
+        }
 
-        stack<Element> p_ElementStack;
-        stack<Attribute> p_AttributeStack;
-        
-        string GetModeName(Mode& mode);
+        mutable shared_mutex                p_Mutex;
+        unordered_map<string_view, Atom>    p_Lookup;
+        // fixed chunks so names already handed out are never relocated by later interning
+        unique_ptr<string[]>                p_Chunks[MaxChunks];
+        uint32_t                            p_Count = 0;
+    };
 
-        void SwitchMode(Mode newMode, char current);
-        void ProcessCharacter(std::string& xmlString, int charIndex);
+    /// <summary>
+    /// Flat node storage behind a DocumentView. Nodes and attributes sit in contiguous pools
+    /// carved from one monotonic arena and link to each other by index, so dropping the arena frees the whole tree.
+    /// </summary>
+    struct NodeArena
+    {
+        static constexpr uint32_t None = UINT32_MAX;
 
-        void CreateElement(Element::Type elementType = Element::Type::Invalid);
-        void CloseElement();
-        void AssignElementValue();
-        void CreateAttribute();
-        void LogCurrentElementName();
-        void LogCurrentAttributes();
+        /// <summary>
+        /// Pass-through to the default resource that counts what the arena asks for
+        /// </summary>
+        struct CountingResource : pmr::memory_resource
+        {
+            uint64_t Allocations = 0;
+            uint64_t Bytes = 0;
 
-        void ClearCurrentElement();
-        void ClearCurrentAttribute();
-    };
+        protected:
+            virtual void*   do_allocate(size_t bytes, size_t alignment) override { Allocations++; Bytes += bytes; return pmr::get_default_resource()->allocate(bytes, alignment); }
+            virtual void    do_deallocate(void* p, size_t bytes, size_t alignment) override { pmr::get_default_resource()->deallocate(p, bytes, alignment); }
+            virtual bool    do_is_equal(const pmr::memory_resource& other) const noexcept override { return this == &other; }
+        };
 
-    static Document ParseString(string& input);
-    
-    namespace utils {
-        static void CleanWhiteSpace(string& input);
-        static string LoadFileAsString(const char* path);
-        static void SaveStringToFile(const char* path, string& str);
-    }
-}
-// All credit to https://github.com/nlohmann/json for these hideous helpful macros
-#define NXML_EXPAND(x) x
-#define NXML_GET_MACRO(_1, _2, _3, _4, _5, _6, _7, _8, _9, _10, _11, _12, _13, _14, _15, _16, _17, _18, _19, _20, _21, _22, _23, _24, _25, _26, _27, _28, _29, _30, _31, _32, _33, _34, _35, _36, _37, _38, _39, _40, _41, _42, _43, _44, _45, _46, _47, _48, _49, _50, _51, _52, _53, _54, _55, _56, _57, _58, _59, _60, _61, _62, _63, _64, NAME, ...) NAME
-#define NXML_PASTE(...) NXML_EXPAND(NXML_GET_MACRO(__VA_ARGS__, \
-        NXML_PASTE64, \
-        NXML_PASTE63, \
-        NXML_PASTE62, \
-        NXML_PASTE61, \
-        NXML_PASTE60, \
-        NXML_PASTE59, \
-        NXML_PASTE58, \
-        NXML_PASTE57, \
-        NXML_PASTE56, \
-        NXML_PASTE55, \
-        NXML_PASTE54, \
-        NXML_PASTE53, \
-        NXML_PASTE52, \
-        NXML_PASTE51, \
-        NXML_PASTE50, \
-        NXML_PASTE49, \
-        NXML_PASTE48, \
-        NXML_PASTE47, \
-        NXML_PASTE46, \
-        NXML_PASTE45, \
-        NXML_PASTE44, \
-        NXML_PASTE43, \
-        NXML_PASTE42, \
-        NXML_PASTE41, \
-        NXML_PASTE40, \
-        NXML_PASTE39, \
-        NXML_PASTE38, \
-        NXML_PASTE37, \
-        NXML_PASTE36, \
-        NXML_PASTE35, \
-        NXML_PASTE34, \
-        NXML_PASTE33, \
-        NXML_PASTE32, \
-        NXML_PASTE31, \
-        NXML_PASTE30, \
-        NXML_PASTE29, \
-        NXML_PASTE28, \
-        NXML_PASTE27, \
-        NXML_PASTE26, \
-        NXML_PASTE25, \
-        NXML_PASTE24, \
-        NXML_PASTE23, \
-        NXML_PASTE22, \
-        NXML_PASTE21, \
-        NXML_PASTE20, \
-        NXML_PASTE19, \
-        NXML_PASTE18, \
-        NXML_PASTE17, \
-        NXML_PASTE16, \
-        NXML_PASTE15, \
-        NXML_PASTE14, \
-        NXML_PASTE13, \
-        NXML_PASTE12, \
-        NXML_PASTE11, \
-        NXML_PASTE10, \
-        NXML_PASTE9, \
-        NXML_PASTE8, \
-        NXML_PASTE7, \
-        NXML_PASTE6, \
-        NXML_PASTE5, \
-        NXML_PASTE4, \
-        NXML_PASTE3, \
-        NXML_PASTE2, \
-        NXML_PASTE1)(__VA_ARGS__))
-#define NXML_PASTE2(func, v1) func(v1)
-#define NXML_PASTE3(func, v1, v2) NXML_PASTE2(func, v1) NXML_PASTE2(func, v2)
-#define NXML_PASTE4(func, v1, v2, v3) NXML_PASTE2(func, v1) NXML_PASTE3(func, v2, v3)
-#define NXML_PASTE5(func, v1, v2, v3, v4) NXML_PASTE2(func, v1) NXML_PASTE4(func, v2, v3, v4)
-#define NXML_PASTE6(func, v1, v2, v3, v4, v5) NXML_PASTE2(func, v1) NXML_PASTE5(func, v2, v3, v4, v5)
-#define NXML_PASTE7(func, v1, v2, v3, v4, v5, v6) NXML_PASTE2(func, v1) NXML_PASTE6(func, v2, v3, v4, v5, v6)
-#define NXML_PASTE8(func, v1, v2, v3, v4, v5, v6, v7) NXML_PASTE2(func, v1) NXML_PASTE7(func, v2, v3, v4, v5, v6, v7)
-#define NXML_PASTE9(func, v1, v2, v3, v4, v5, v6, v7, v8) NXML_PASTE2(func, v1) NXML_PASTE8(func, v2, v3, v4, v5, v6, v7, v8)
-#define NXML_PASTE10(func, v1, v2, v3, v4, v5, v6, v7, v8, v9) NXML_PASTE2(func, v1) NXML_PASTE9(func, v2, v3, v4, v5, v6, v7, v8, v9)
-#define NXML_PASTE11(func, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10) NXML_PASTE2(func, v1) NXML_PASTE10(func, v2, v3, v4, v5, v6, v7, v8, v9, v10)
-#define NXML_PASTE12(func, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11) NXML_PASTE2(func, v1) NXML_PASTE11(func, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11)
-#define NXML_PASTE13(func, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12) NXML_PASTE2(func, v1) NXML_PASTE12(func, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12)
-#define NXML_PASTE14(func, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13) NXML_PASTE2(func, v1) NXML_PASTE13(func, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13)
-#define NXML_PASTE15(func, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14) NXML_PASTE2(func, v1) NXML_PASTE14(func, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14)
-#define NXML_PASTE16(func, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15) NXML_PASTE2(func, v1) NXML_PASTE15(func, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15)
-#define NXML_PASTE17(func, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16) NXML_PASTE2(func, v1) NXML_PASTE16(func, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16)
-#define NXML_PASTE18(func, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17) NXML_PASTE2(func, v1) NXML_PASTE17(func, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17)
-#define NXML_PASTE19(func, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18) NXML_PASTE2(func, v1) NXML_PASTE18(func, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18)
-#define NXML_PASTE20(func, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19) NXML_PASTE2(func, v1) NXML_PASTE19(func, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19)
-#define NXML_PASTE21(func, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20) NXML_PASTE2(func, v1) NXML_PASTE20(func, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20)
-#define NXML_PASTE22(func, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21) NXML_PASTE2(func, v1) NXML_PASTE21(func, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21)
-#define NXML_PASTE23(func, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22) NXML_PASTE2(func, v1) NXML_PASTE22(func, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22)
-#define NXML_PASTE24(func, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23) NXML_PASTE2(func, v1) NXML_PASTE23(func, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23)
-#define NXML_PASTE25(func, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24) NXML_PASTE2(func, v1) NXML_PASTE24(func, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24)
-#define NXML_PASTE26(func, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25) NXML_PASTE2(func, v1) NXML_PASTE25(func, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25)
-#define NXML_PASTE27(func, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26) NXML_PASTE2(func, v1) NXML_PASTE26(func, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26)
-#define NXML_PASTE28(func, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27) NXML_PASTE2(func, v1) NXML_PASTE27(func, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27)
-#define NXML_PASTE29(func, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28) NXML_PASTE2(func, v1) NXML_PASTE28(func, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28)
-#define NXML_PASTE30(func, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29) NXML_PASTE2(func, v1) NXML_PASTE29(func, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29)
-#define NXML_PASTE31(func, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30) NXML_PASTE2(func, v1) NXML_PASTE30(func, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30)
-#define NXML_PASTE32(func, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31) NXML_PASTE2(func, v1) NXML_PASTE31(func, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31)
-#define NXML_PASTE33(func, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32) NXML_PASTE2(func, v1) NXML_PASTE32(func, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32)
-#define NXML_PASTE34(func, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33) NXML_PASTE2(func, v1) NXML_PASTE33(func, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33)
-#define NXML_PASTE35(func, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33, v34) NXML_PASTE2(func, v1) NXML_PASTE34(func, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33, v34)
-#define NXML_PASTE36(func, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33, v34, v35) NXML_PASTE2(func, v1) NXML_PASTE35(func, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33, v34, v35)
-#define NXML_PASTE37(func, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33, v34, v35, v36) NXML_PASTE2(func, v1) NXML_PASTE36(func, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33, v34, v35, v36)
-#define NXML_PASTE38(func, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33, v34, v35, v36, v37) NXML_PASTE2(func, v1) NXML_PASTE37(func, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33, v34, v35, v36, v37)
-#define NXML_PASTE39(func, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33, v34, v35, v36, v37, v38) NXML_PASTE2(func, v1) NXML_PASTE38(func, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33, v34, v35, v36, v37, v38)
-#define NXML_PASTE40(func, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33, v34, v35, v36, v37, v38, v39) NXML_PASTE2(func, v1) NXML_PASTE39(func, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33, v34, v35, v36, v37, v38, v39)
-#define NXML_PASTE41(func, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33, v34, v35, v36, v37, v38, v39, v40) NXML_PASTE2(func, v1) NXML_PASTE40(func, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33, v34, v35, v36, v37, v38, v39, v40)
-#define NXML_PASTE42(func, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33, v34, v35, v36, v37, v38, v39, v40, v41) NXML_PASTE2(func, v1) NXML_PASTE41(func, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33, v34, v35, v36, v37, v38, v39, v40, v41)
-#define NXML_PASTE43(func, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33, v34, v35, v36, v37, v38, v39, v40, v41, v42) NXML_PASTE2(func, v1) NXML_PASTE42(func, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33, v34, v35, v36, v37, v38, v39, v40, v41, v42)
-#define NXML_PASTE44(func, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33, v34, v35, v36, v37, v38, v39, v40, v41, v42, v43) NXML_PASTE2(func, v1) NXML_PASTE43(func, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33, v34, v35, v36, v37, v38, v39, v40, v41, v42, v43)
-#define NXML_PASTE45(func, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33, v34, v35, v36, v37, v38, v39, v40, v41, v42, v43, v44) NXML_PASTE2(func, v1) NXML_PASTE44(func, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33, v34, v35, v36, v37, v38, v39, v40, v41, v42, v43, v44)
-#define NXML_PASTE46(func, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33, v34, v35, v36, v37, v38, v39, v40, v41, v42, v43, v44, v45) NXML_PASTE2(func, v1) NXML_PASTE45(func, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33, v34, v35, v36, v37, v38, v39, v40, v41, v42, v43, v44, v45)
-#define NXML_PASTE47(func, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33, v34, v35, v36, v37, v38, v39, v40, v41, v42, v43, v44, v45, v46) NXML_PASTE2(func, v1) NXML_PASTE46(func, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33, v34, v35, v36, v37, v38, v39, v40, v41, v42, v43, v44, v45, v46)
-#define NXML_PASTE48(func, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33, v34, v35, v36, v37, v38, v39, v40, v41, v42, v43, v44, v45, v46, v47) NXML_PASTE2(func, v1) NXML_PASTE47(func, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33, v34, v35, v36, v37, v38, v39, v40, v41, v42, v43, v44, v45, v46, v47)
-#define NXML_PASTE49(func, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33, v34, v35, v36, v37, v38, v39, v40, v41, v42, v43, v44, v45, v46, v47, v48) NXML_PASTE2(func, v1) NXML_PASTE48(func, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33, v34, v35, v36, v37, v38, v39, v40, v41, v42, v43, v44, v45, v46, v47, v48)
-#define NXML_PASTE50(func, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33, v34, v35, v36, v37, v38, v39, v40, v41, v42, v43, v44, v45, v46, v47, v48, v49) NXML_PASTE2(func, v1) NXML_PASTE49(func, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33, v34, v35, v36, v37, v38, v39, v40, v41, v42, v43, v44, v45, v46, v47, v48, v49)
-#define NXML_PASTE51(func, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33, v34, v35, v36, v37, v38, v39, v40, v41, v42, v43, v44, v45, v46, v47, v48, v49, v50) NXML_PASTE2(func, v1) NXML_PASTE50(func, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33, v34, v35, v36, v37, v38, v39, v40, v41, v42, v43, v44, v45, v46, v47, v48, v49, v50)
-#define NXML_PASTE52(func, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33, v34, v35, v36, v37, v38, v39, v40, v41, v42, v43, v44, v45, v46, v47, v48, v49, v50, v51) NXML_PASTE2(func, v1) NXML_PASTE51(func, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33, v34, v35, v36, v37, v38, v39, v40, v41, v42, v43, v44, v45, v46, v47, v48, v49, v50, v51)
-#define NXML_PASTE53(func, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33, v34, v35, v36, v37, v38, v39, v40, v41, v42, v43, v44, v45, v46, v47, v48, v49, v50, v51, v52) NXML_PASTE2(func, v1) NXML_PASTE52(func, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33, v34, v35, v36, v37, v38, v39, v40, v41, v42, v43, v44, v45, v46, v47, v48, v49, v50, v51, v52)
-#define NXML_PASTE54(func, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33, v34, v35, v36, v37, v38, v39, v40, v41, v42, v43, v44, v45, v46, v47, v48, v49, v50, v51, v52, v53) NXML_PASTE2(func, v1) NXML_PASTE53(func, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33, v34, v35, v36, v37, v38, v39, v40, v41, v42, v43, v44, v45, v46, v47, v48, v49, v50, v51, v52, v53)
-#define NXML_PASTE55(func, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33, v34, v35, v36, v37, v38, v39, v40, v41, v42, v43, v44, v45, v46, v47, v48, v49, v50, v51, v52, v53, v54) NXML_PASTE2(func, v1) NXML_PASTE54(func, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33, v34, v35, v36, v37, v38, v39, v40, v41, v42, v43, v44, v45, v46, v47, v48, v49, v50, v51, v52, v53, v54)
-#define NXML_PASTE56(func, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33, v34, v35, v36, v37, v38, v39, v40, v41, v42, v43, v44, v45, v46, v47, v48, v49, v50, v51, v52, v53, v54, v55) NXML_PASTE2(func, v1) NXML_PASTE55(func, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33, v34, v35, v36, v37, v38, v39, v40, v41, v42, v43, v44, v45, v46, v47, v48, v49, v50, v51, v52, v53, v54, v55)
-#define NXML_PASTE57(func, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33, v34, v35, v36, v37, v38, v39, v40, v41, v42, v43, v44, v45, v46, v47, v48, v49, v50, v51, v52, v53, v54, v55, v56) NXML_PASTE2(func, v1) NXML_PASTE56(func, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33, v34, v35, v36, v37, v38, v39, v40, v41, v42, v43, v44, v45, v46, v47, v48, v49, v50, v51, v52, v53, v54, v55, v56)
-#define NXML_PASTE58(func, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33, v34, v35, v36, v37, v38, v39, v40, v41, v42, v43, v44, v45, v46, v47, v48, v49, v50, v51, v52, v53, v54, v55, v56, v57) NXML_PASTE2(func, v1) NXML_PASTE57(func, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33, v34, v35, v36, v37, v38, v39, v40, v41, v42, v43, v44, v45, v46, v47, v48, v49, v50, v51, v52, v53, v54, v55, v56, v57)
-#define NXML_PASTE59(func, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33, v34, v35, v36, v37, v38, v39, v40, v41, v42, v43, v44, v45, v46, v47, v48, v49, v50, v51, v52, v53, v54, v55, v56, v57, v58) NXML_PASTE2(func, v1) NXML_PASTE58(func, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33, v34, v35, v36, v37, v38, v39, v40, v41, v42, v43, v44, v45, v46, v47, v48, v49, v50, v51, v52, v53, v54, v55, v56, v57, v58)
-#define NXML_PASTE60(func, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33, v34, v35, v36, v37, v38, v39, v40, v41, v42, v43, v44, v45, v46, v47, v48, v49, v50, v51, v52, v53, v54, v55, v56, v57, v58, v59) NXML_PASTE2(func, v1) NXML_PASTE59(func, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33, v34, v35, v36, v37, v38, v39, v40, v41, v42, v43, v44, v45, v46, v47, v48, v49, v50, v51, v52, v53, v54, v55, v56, v57, v58, v59)
-#define NXML_PASTE61(func, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33, v34, v35, v36, v37, v38, v39, v40, v41, v42, v43, v44, v45, v46, v47, v48, v49, v50, v51, v52, v53, v54, v55, v56, v57, v58, v59, v60) NXML_PASTE2(func, v1) NXML_PASTE60(func, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33, v34, v35, v36, v37, v38, v39, v40, v41, v42, v43, v44, v45, v46, v47, v48, v49, v50, v51, v52, v53, v54, v55, v56, v57, v58, v59, v60)
-#define NXML_PASTE62(func, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33, v34, v35, v36, v37, v38, v39, v40, v41, v42, v43, v44, v45, v46, v47, v48, v49, v50, v51, v52, v53, v54, v55, v56, v57, v58, v59, v60, v61) NXML_PASTE2(func, v1) NXML_PASTE61(func, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33, v34, v35, v36, v37, v38, v39, v40, v41, v42, v43, v44, v45, v46, v47, v48, v49, v50, v51, v52, v53, v54, v55, v56, v57, v58, v59, v60, v61)
-#define NXML_PASTE63(func, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33, v34, v35, v36, v37, v38, v39, v40, v41, v42, v43, v44, v45, v46, v47, v48, v49, v50, v51, v52, v53, v54, v55, v56, v57, v58, v59, v60, v61, v62) NXML_PASTE2(func, v1) NXML_PASTE62(func, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33, v34, v35, v36, v37, v38, v39, v40, v41, v42, v43, v44, v45, v46, v47, v48, v49, v50, v51, v52, v53, v54, v55, v56, v57, v58, v59, v60, v61, v62)
-#define NXML_PASTE64(func, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33, v34, v35, v36, v37, v38, v39, v40, v41, v42, v43, v44, v45, v46, v47, v48, v49, v50, v51, v52, v53, v54, v55, v56, v57, v58, v59, v60, v61, v62, v63) NXML_PASTE2(func, v1) NXML_PASTE63(func, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33, v34, v35, v36, v37, v38, v39, v40, v41, v42, v43, v44, v45, v46, v47, v48, v49, v50, v51, v52, v53, v54, v55, v56, v57, v58, v59, v60, v61, v62, v63)
+        struct Node
+        {
+            Element::Type ElementType = Element::Type::Invalid;
+            Atom Name = NameTable::None;
 
+            string_view InnerValue;
 
-#ifdef NXML_IMPL
+            uint32_t Parent         = None;
+            uint32_t FirstChild     = None;
+            uint32_t LastChild      = None;
+            uint32_t NextSibling    = None;
+            uint32_t FirstAttribute = None;
+            uint32_t LastAttribute  = None;
 
-#define NXML_ASSERT(exp, msg) assert(((void)msg, exp))
+            // bytes of Source the element was parsed from, '<' of the start tag up to the end of its close tag
+            uint32_t SourceBegin    = None;
+            uint32_t SourceEnd      = None;
+        };
 
-nxml::Parser::Parser()
-{
-    p_Mode = Parser::Mode::Declaration;
-}
+        struct AttributeNode
+        {
+            Atom Key = NameTable::None;
+            uint32_t Next = None;
 
-nxml::Element::Element(Element::Type type) : ElementType(type)
-{
+            string_view SerializedValue;
+        };
 
-}
+        NodeArena(shared_ptr<NameTable> names = nullptr);
 
-nxml::Element nxml::Element::Invalid = nxml::Element(Element::Type::Invalid);
+        CountingResource Upstream;
+        pmr::monotonic_buffer_resource Arena;
+        shared_ptr<NameTable> Names;
+        // unsynchronised front for Names, keyed by the table's own copies of the names
+        unordered_map<string_view, Atom> NameCache;
 
-nxml::Element&  nxml::Element::operator[](const char* key)
-{
-    for (Element& e : InnerElements)
-    {
-        if (e.ElementName == std::string(key)) return e;
-    }
-    return Element::Invalid;
-}
+        pmr::vector<Node> Nodes;
+        pmr::vector<AttributeNode> Attributes;
 
-nxml::Element& nxml::Element::operator[](const ElementWithAttribute& search)
-{
-    for (Element& e : InnerElements)
-    {
-        if (e.ElementName == std::string(search.ElementName))
+        uint32_t FirstRoot  = None;
+        uint32_t LastRoot   = None;
+
+        // text the node source spans refer to
+        string_view Source;
+        // one flag per node, set on nodes changed since parsing and on their ancestors. Sized on the first edit
+        pmr::vector<uint8_t> Dirty;
+
+        enum class CacheState : uint8_t
         {
-            for (Attribute& attr : e.Attributes)
+            Empty,
+            Int,
+            Double,
+            NotInt,
+            NotDouble
+        };
+
+        struct CachedValue
+        {
+            CacheState State = CacheState::Empty;
+            union
+            {
+                int64_t Int;
+                double  Double;
+            };
+        };
+
+        // decoded numbers per node, sized on first use when enabled, see DocumentView::SetValueCaching
+        bool CacheValues = false;
+        pmr::vector<CachedValue> ValueCache;
+
+        uint32_t    AppendNode(uint32_t parent, Element::Type elementType, string_view name);
+        uint32_t    AppendAttribute(uint32_t node, string_view key, string_view value);
+        string_view Copy(string_view value);
+        Atom        Intern(string_view name);
+        // NameTable::None when the name has never been interned, names seen by this arena resolve without the table lock
+        Atom        Find(string_view name) const;
+        // nullptr unless CacheValues is set
+        CachedValue* CacheFor(uint32_t node);
+
+        void        MarkDirty(uint32_t node);
+        bool        IsDirty(uint32_t node) const { return node < Dirty.size() && Dirty[node] != 0; }
+    };
+
+    class ElementRange;
+    class AttributeRange;
+
+    /// <summary>
+    /// Handle to a node stored in a DocumentView. Cheap to copy, navigates like Element.
+    /// Names and values point into the document source until changed through the handle.
+    /// </summary>
+    class ElementView
+    {
+    public:
+        static const ElementView Invalid;
+
+        ElementView() = default;
+        ElementView(NodeArena* nodes, uint32_t index) : p_Nodes(nodes), p_Index(index) {}
+
+        bool            IsValid() const { return p_Nodes != nullptr && p_Index != NodeArena::None; }
+        bool            operator==(const ElementView& other) const { return p_Nodes == other.p_Nodes && p_Index == other.p_Index; }
+        bool            operator!=(const ElementView& other) const { return !(*this == other); }
+
+        Element::Type   ElementType() const;
+        string_view     ElementName() const;
+        Atom            NameAtom() const;
+        string_view     InnerValue() const;
+
+        ElementRange    InnerElements() const;
+        AttributeRange  Attributes() const;
+        ElementView     Parent() const;
+
+        ElementView     operator[](const char* key) const;
+        ElementView     operator[](const ElementWithAttribute& search) const;
+
+        void            SetInnerValue(string_view value);
+        void            SetAttribute(string_view key, string_view value);
+
+        // true once the element or anything below it has been changed through a handle
+        bool            IsDirty() const { return IsValid() && p_Nodes->IsDirty(p_Index); }
+        // the text the element was parsed from, empty for documents without source spans
+        string_view     SourceText() const;
+
+        // decoded InnerValue, numbers are remembered per node when the document caches values
+        int64_t         AsInt(int64_t fallback = 0) const;
+        double          AsDouble(double fallback = 0.0) const;
+        bool            AsBool(bool fallback = false) const;
+        Date            AsDate() const;
+
+        void            SetInt(int64_t value);
+        void            SetDouble(double value);
+        void            SetBool(bool value) { SetInnerValue(value ? "true" : "false"); }
+        void            SetDate(const Date& value);
+
+        Element         ToElement() const;
+
+    protected:
+        NodeArena*  p_Nodes = nullptr;
+        uint32_t    p_Index = NodeArena::None;
+    };
+
+    /// <summary>
+    /// Forward range over sibling ElementViews, following next-sibling links
+    /// </summary>
+    class ElementRange
+    {
+    public:
+        struct Iterator
+        {
+            NodeArena*  Nodes;
+            uint32_t    Index;
+
+            ElementView operator*() const { return ElementView(Nodes, Index); }
+            Iterator&   operator++() { Index = Nodes->Nodes[Index].NextSibling; return *this; }
+            bool        operator!=(const Iterator& other) const { return Index != other.Index; }
+            bool        operator==(const Iterator& other) const { return Index == other.Index; }
+        };
+
+        ElementRange(NodeArena* nodes, uint32_t first) : p_Nodes(nodes), p_First(first) {}
+
+        Iterator    begin() const { return Iterator{ p_Nodes, p_First }; }
+        Iterator    end() const { return Iterator{ p_Nodes, NodeArena::None }; }
+        bool        empty() const { return p_First == NodeArena::None; }
+        size_t      size() const;
+        NodeArena*  Arena() const { return p_Nodes; }
+
+    protected:
+        NodeArena*  p_Nodes;
+        uint32_t    p_First;
+    };
+
+    /// <summary>
+    /// Forward range over the attributes of an ElementView
+    /// </summary>
+    class AttributeRange
+    {
+    public:
+        struct Iterator
+        {
+            NodeArena*  Nodes;
+            uint32_t    Index;
+
+            AttributeView operator*() const { auto& a = Nodes->Attributes[Index]; return AttributeView{ Nodes->Names->Name(a.Key), a.SerializedValue }; }
+            Iterator&   operator++() { Index = Nodes->Attributes[Index].Next; return *this; }
+            bool        operator!=(const Iterator& other) const { return Index != other.Index; }
+            bool        operator==(const Iterator& other) const { return Index == other.Index; }
+        };
+
+        AttributeRange(NodeArena* nodes, uint32_t first) : p_Nodes(nodes), p_First(first) {}
+
+        Iterator    begin() const { return Iterator{ p_Nodes, p_First }; }
+        Iterator    end() const { return Iterator{ p_Nodes, NodeArena::None }; }
+        bool        empty() const { return p_First == NodeArena::None; }
+
+    protected:
+        NodeArena*  p_Nodes;
+        uint32_t    p_First;
+    };
+
+    /// <summary>
+    /// Document produced by the in-situ parse mode, either owning or borrowing its source buffer.
+    /// All nodes live in a single NodeArena, strings assigned after parsing are copied into it.
+    /// </summary>
+    struct DocumentView
+    {
+        Declaration Decl;
+        string_view Source;
+        ParseStats Stats;
+
+        DocumentView(shared_ptr<NameTable> names = nullptr);
+        DocumentView(DocumentView&&) = default;
+        DocumentView& operator=(DocumentView&&) = default;
+        DocumentView(const DocumentView&) = delete;
+        DocumentView& operator=(const DocumentView&) = delete;
+
+        ElementView     operator[](const char* key) const;
+        ElementRange    RootElements() const;
+        size_t          NodeCount() const;
+        shared_ptr<NameTable> Names() const;
+
+        // remember decoded numbers per node so repeated AsInt / AsDouble calls skip the conversion.
+        // The cache is filled on read, so a caching document must not be read from several threads at once.
+        void            SetValueCaching(bool enabled);
+
+        Document        ToDocument() const;
+        string          ToString();
+        // the source with the edits made through ElementViews applied, unchanged subtrees are copied byte for byte
+        string          ToSourceString();
+
+        // maps a snapshot written by Document::SaveBinary, names and values point into the mapping.
+        // With a source the snapshot must have been made from exactly that xml, an empty source included
+        bool            LoadBinary(const char* path);
+        bool            LoadBinary(const char* path, string_view source);
+
+    protected:
+        bool            LoadSnapshot(const char* path, const string_view* source);
+
+        friend class Parser;
+
+        unique_ptr<NodeArena> p_Nodes;
+        shared_ptr<const void> p_SourceOwner;
+    };
+
+    class LazyDocument;
+    class LazyElementRange;
+    class LazyAttributeRange;
+
+    /// <summary>
+    /// Handle to an element of a LazyDocument. Names are read straight from the source,
+    /// the value and attributes are decoded the first time the element is looked at.
+    /// </summary>
+    class LazyElement
+    {
+    public:
+        static const LazyElement Invalid;
+
+        LazyElement() = default;
+        LazyElement(const LazyDocument* doc, uint32_t index) : p_Doc(doc), p_Index(index) {}
+
+        bool                IsValid() const;
+        bool                operator==(const LazyElement& other) const { return p_Doc == other.p_Doc && p_Index == other.p_Index; }
+        bool                operator!=(const LazyElement& other) const { return !(*this == other); }
+
+        Element::Type       ElementType() const;
+        string_view         ElementName() const;
+        string_view         InnerValue() const;
+
+        LazyElementRange    InnerElements() const;
+        LazyAttributeRange  Attributes() const;
+
+        LazyElement         operator[](const char* key) const;
+        LazyElement         operator[](const ElementWithAttribute& search) const;
+
+        Element             ToElement() const;
+
+    protected:
+        const LazyDocument* p_Doc = nullptr;
+        uint32_t            p_Index = UINT32_MAX;
+    };
+
+    /// <summary>
+    /// Forward range over sibling LazyElements, following the structural index
+    /// </summary>
+    class LazyElementRange
+    {
+    public:
+        struct Iterator
+        {
+            const LazyDocument* Doc;
+            uint32_t            Index;
+
+            LazyElement operator*() const { return LazyElement(Doc, Index); }
+            Iterator&   operator++();
+            bool        operator!=(const Iterator& other) const { return Index != other.Index; }
+            bool        operator==(const Iterator& other) const { return Index == other.Index; }
+        };
+
+        LazyElementRange(const LazyDocument* doc, uint32_t first) : p_Doc(doc), p_First(first) {}
+
+        Iterator    begin() const { return Iterator{ p_Doc, p_First }; }
+        Iterator    end() const { return Iterator{ p_Doc, UINT32_MAX }; }
+        bool        empty() const { return p_First == UINT32_MAX; }
+        size_t      size() const;
+
+    protected:
+        const LazyDocument* p_Doc;
+        uint32_t            p_First;
+    };
+
+    /// <summary>
+    /// Attributes of a materialised LazyElement
+    /// </summary>
+    class LazyAttributeRange
+    {
+    public:
+        struct Iterator
+        {
+            const LazyDocument* Doc;
+            uint32_t            Index;
+
+            AttributeView   operator*() const;
+            Iterator&       operator++() { Index++; return *this; }
+            bool            operator!=(const Iterator& other) const { return Index != other.Index; }
+            bool            operator==(const Iterator& other) const { return Index == other.Index; }
+        };
+
+        LazyAttributeRange(const LazyDocument* doc, uint32_t first, uint32_t count) : p_Doc(doc), p_First(first), p_Count(count) {}
+
+        Iterator    begin() const { return Iterator{ p_Doc, p_First }; }
+        Iterator    end() const { return Iterator{ p_Doc, p_First + p_Count }; }
+        bool        empty() const { return p_Count == 0; }
+        size_t      size() const { return p_Count; }
+
+    protected:
+        const LazyDocument* p_Doc;
+        uint32_t            p_First;
+        uint32_t            p_Count;
+    };
+
+    /// <summary>
+    /// Two stage document. Building it only records where every element's tags start and end in a
+    /// compact structural index, an element's value and attributes are decoded on first access.
+    /// Navigation fills in that state, so a LazyDocument must not be navigated from several threads at once.
+    /// </summary>
+    class LazyDocument
+    {
+    public:
+        static constexpr uint32_t None = UINT32_MAX;
+
+        string_view Source;
+
+        LazyDocument();
+        LazyDocument(LazyDocument&&) = default;
+        LazyDocument& operator=(LazyDocument&&) = default;
+        LazyDocument(const LazyDocument&) = delete;
+        LazyDocument& operator=(const LazyDocument&) = delete;
+
+        // indexes xml, which must outlive the document unless owner keeps it alive.
+        // Inputs of 4GB or more give an empty document with no elements
+        static LazyDocument FromString(string_view xml, shared_ptr<const void> owner = nullptr);
+
+        LazyElement         operator[](const char* key) const;
+        LazyElementRange    RootElements() const;
+
+        size_t              IndexedCount() const;
+        size_t              MaterializedCount() const;
+
+        Document            ToDocument() const;
+
+    protected:
+        friend class LazyElement;
+        friend class LazyElementRange;
+        friend class LazyAttributeRange;
+
+        struct Entry
+        {
+            uint32_t Open;          // '<' of the start tag
+            uint32_t OpenEnd;       // '>' of the start tag
+            uint32_t Close;         // '<' of the end tag, OpenEnd when self closing
+            uint32_t NextSibling;   // children follow their parent directly, so no child link is needed
+        };
+
+        struct Detail
+        {
+            bool        Ready = false;
+            string_view Value;
+            uint32_t    FirstAttribute = 0;
+            uint32_t    AttributeCount = 0;
+        };
+
+        struct State
+        {
+            vector<Entry>           Entries;
+            // sized on the first materialisation, so indexing alone never pays for it
+            vector<Detail>          Details;
+            vector<AttributeView>   Attributes;
+            // decoded copies of values holding references, a deque so earlier ones never move
+            deque<string>           Decoded;
+            size_t                  Materialized = 0;
+            uint32_t                FirstRoot = None;
+        };
+
+        unique_ptr<State>       p_State;
+        shared_ptr<const void>  p_SourceOwner;
+
+        void            BuildIndex();
+        uint32_t        FirstChild(uint32_t index) const;
+        Element::Type   TypeOf(uint32_t index) const;
+        string_view     NameOf(uint32_t index) const;
+        const Detail&   Materialize(uint32_t index) const;
+        string_view     Decode(string_view text) const;
+    };
+
+    class FrozenDocument;
+    class FrozenElementRange;
+    class FrozenAttributeRange;
+
+    /// <summary>
+    /// Read-only handle to an element of a FrozenDocument. Failed lookups return an invalid handle
+    /// rather than a shared object, so nothing reachable from a FrozenDocument can be written to.
+    /// </summary>
+    class FrozenElement
+    {
+    public:
+        FrozenElement() = default;
+        FrozenElement(const FrozenDocument* doc, uint32_t index) : p_Doc(doc), p_Index(index) {}
+
+        bool                    IsValid() const { return p_Doc != nullptr && p_Index != UINT32_MAX; }
+        bool                    operator==(const FrozenElement& other) const { return p_Doc == other.p_Doc && p_Index == other.p_Index; }
+        bool                    operator!=(const FrozenElement& other) const { return !(*this == other); }
+
+        Element::Type           ElementType() const;
+        string_view             ElementName() const;
+        string_view             InnerValue() const;
+
+        FrozenElementRange      InnerElements() const;
+        FrozenAttributeRange    Attributes() const;
+        // value of the attribute named key, empty when there is none
+        string_view             Attribute(string_view key) const;
+
+        FrozenElement           operator[](const char* key) const;
+        FrozenElement           operator[](const ElementWithAttribute& search) const;
+
+        int64_t                 AsInt(int64_t fallback = 0) const;
+        double                  AsDouble(double fallback = 0.0) const;
+        bool                    AsBool(bool fallback = false) const;
+        Date                    AsDate() const;
+
+        Element                 ToElement() const;
+
+    protected:
+        const FrozenDocument*   p_Doc = nullptr;
+        uint32_t                p_Index = UINT32_MAX;
+    };
+
+    /// <summary>
+    /// Forward range over sibling FrozenElements
+    /// </summary>
+    class FrozenElementRange
+    {
+    public:
+        struct Iterator
+        {
+            const FrozenDocument*   Doc;
+            uint32_t                Index;
+
+            FrozenElement   operator*() const { return FrozenElement(Doc, Index); }
+            Iterator&       operator++();
+            bool            operator!=(const Iterator& other) const { return Index != other.Index; }
+            bool            operator==(const Iterator& other) const { return Index == other.Index; }
+        };
+
+        FrozenElementRange(const FrozenDocument* doc, uint32_t first) : p_Doc(doc), p_First(first) {}
+
+        Iterator    begin() const { return Iterator{ p_Doc, p_First }; }
+        Iterator    end() const { return Iterator{ p_Doc, UINT32_MAX }; }
+        bool        empty() const { return p_First == UINT32_MAX; }
+        size_t      size() const;
+
+    protected:
+        const FrozenDocument*   p_Doc;
+        uint32_t                p_First;
+    };
+
+    /// <summary>
+    /// Attributes of a FrozenElement, stored next to each other
+    /// </summary>
+    class FrozenAttributeRange
+    {
+    public:
+        struct Iterator
+        {
+            const FrozenDocument*   Doc;
+            uint32_t                Index;
+
+            AttributeView   operator*() const;
+            Iterator&       operator++() { Index++; return *this; }
+            bool            operator!=(const Iterator& other) const { return Index != other.Index; }
+            bool            operator==(const Iterator& other) const { return Index == other.Index; }
+        };
+
+        FrozenAttributeRange(const FrozenDocument* doc, uint32_t first, uint32_t count) : p_Doc(doc), p_First(first), p_Count(count) {}
+
+        Iterator    begin() const { return Iterator{ p_Doc, p_First }; }
+        Iterator    end() const { return Iterator{ p_Doc, p_First + p_Count }; }
+        bool        empty() const { return p_Count == 0; }
+        size_t      size() const { return p_Count; }
+
+    protected:
+        const FrozenDocument*   p_Doc;
+        uint32_t                p_First;
+        uint32_t                p_Count;
+    };
+
+    /// <summary>
+    /// Immutable copy of a Document packed into three flat tables and one string buffer. Nothing changes
+    /// after construction, so any number of threads may read one without locking.
+    /// </summary>
+    class FrozenDocument
+    {
+    public:
+        static constexpr uint32_t None = UINT32_MAX;
+
+        explicit FrozenDocument(const Document& doc);
+        FrozenDocument(const FrozenDocument&) = delete;
+        FrozenDocument& operator=(const FrozenDocument&) = delete;
+
+        FrozenElement       operator[](const char* key) const;
+        FrozenElementRange  RootElements() const { return FrozenElementRange(this, p_Nodes.empty() ? None : 0); }
+
+        size_t              NodeCount() const { return p_Nodes.size(); }
+        // bytes held by the tables and strings
+        size_t              MemoryUsage() const;
+
+        Document            ToDocument() const;
+
+    protected:
+        friend class FrozenElement;
+        friend class FrozenElementRange;
+        friend class FrozenAttributeRange;
+
+        struct Node
+        {
+            uint32_t        Name;
+            Element::Type   ElementType;
+            uint32_t        Value;
+            uint32_t        ValueLength;
+            // pre-order, so the first child of a node with children is the node after it
+            uint32_t        NextSibling;
+            uint32_t        FirstAttribute;
+            uint32_t        AttributeCount;
+            bool            HasChildren;
+        };
+
+        struct AttributeNode
+        {
+            uint32_t Key;
+            uint32_t Value;
+            uint32_t ValueLength;
+        };
+
+        struct NameRef
+        {
+            uint32_t Offset;
+            uint32_t Length;
+        };
+
+        using NameMap = unordered_map<string, uint32_t>;
+
+        vector<Node>                            p_Nodes;
+        vector<AttributeNode>                   p_Attributes;
+        vector<NameRef>                         p_Names;
+        string                                  p_Strings;
+        // keyed by views into p_Strings, which is final once the constructor is done
+        unordered_map<string_view, uint32_t>    p_NameIndex;
+
+        uint32_t        AddName(const string& name, NameMap& names);
+        uint32_t        AddString(const string& value);
+        uint32_t        AddElement(const Element& e, NameMap& names);
+
+        string_view     NameOf(uint32_t name) const { return string_view(p_Strings).substr(p_Names[name].Offset, p_Names[name].Length); }
+        string_view     StringAt(uint32_t offset, uint32_t length) const { return string_view(p_Strings).substr(offset, length); }
+        // None when no element or attribute carries the name
+        uint32_t        FindName(string_view name) const;
+    };
+
+    /// <summary>
+    /// RCU style publication point for FrozenDocuments. A reloader publishes new versions with Publish,
+    /// readers holding a snapshot keep it alive and unchanged until they let go of it.
+    /// </summary>
+    class FrozenDocumentHandle
+    {
+    public:
+        FrozenDocumentHandle(shared_ptr<const FrozenDocument> doc = nullptr) : p_Current(std::move(doc)) {}
+
+        // atomically replaces the current version, the previous one is freed by its last reader
+        void                                Publish(shared_ptr<const FrozenDocument> doc);
+        shared_ptr<const FrozenDocument>    Load() const;
+        uint64_t                            Version() const { return p_Version.load(std::memory_order_acquire); }
+
+        /// <summary>
+        /// Per-thread view of a handle. While no new version is published, Current costs one atomic load
+        /// of a counter that is only ever written by Publish, so readers on many cores do not contend.
+        /// A Reader must stay on one thread.
+        /// </summary>
+        class Reader
+        {
+        public:
+            Reader(const FrozenDocumentHandle& handle) : p_Handle(handle), p_Version(UINT64_MAX) {}
+
+            // the snapshot stays valid until the next call to Current on this reader
+            const FrozenDocument*   Current();
+
+        protected:
+            const FrozenDocumentHandle&         p_Handle;
+            shared_ptr<const FrozenDocument>    p_Snapshot;
+            uint64_t                            p_Version;
+        };
+
+    protected:
+        shared_ptr<const FrozenDocument>    p_Current;
+        atomic<uint64_t>                    p_Version{ 0 };
+    };
+
+    /// <summary>
+    /// Path expression compiled once and evaluated against Documents or DocumentViews any number of times.
+    /// Supports child steps (a/b), descendant steps (a//b), the * wildcard and
+    /// predicates [@attr], [@attr='value'] and [n] (1-based, among the matching siblings).
+    /// Results point at nodes in the queried tree, nothing is copied.
+    /// </summary>
+    class Query
+    {
+    public:
+        Query(string_view expression);
+
+        bool            IsValid() const { return p_Error.empty(); }
+        const string&   Error() const { return p_Error; }
+        const string&   Expression() const { return p_Expression; }
+
+        // results are appended in document order, evaluation starts at the children of the given node
+        vector<Element*>    Select(Document& doc) const;
+        vector<Element*>    Select(Element& element) const;
+        void                Select(Document& doc, vector<Element*>& results) const;
+        void                Select(Element& element, vector<Element*>& results) const;
+
+        vector<ElementView> Select(const DocumentView& doc) const;
+        vector<ElementView> Select(ElementView element) const;
+        void                Select(const DocumentView& doc, vector<ElementView>& results) const;
+        void                Select(ElementView element, vector<ElementView>& results) const;
+
+        // first match or Element::Invalid / ElementView::Invalid
+        Element&            SelectFirst(Document& doc) const;
+        ElementView         SelectFirst(const DocumentView& doc) const;
+
+    protected:
+        template <typename Traits> friend struct QueryEvaluator;
+
+        struct Predicate
+        {
+            // attribute test when Position is 0
+            size_t  Position = 0;
+            string  Attribute;
+            string  Value;
+            bool    HasValue = false;
+        };
+
+        struct Step
+        {
+            bool                Descendant = false;
+            // empty for the * wildcard
+            string              Name;
+            vector<Predicate>   Predicates;
+        };
+
+        string          p_Expression;
+        string          p_Error;
+        vector<Step>    p_Steps;
+
+        void            Compile();
+    };
+
+    /// <summary>
+    /// Paths a parse is restricted to, such as "catalog/book/@id" or "catalog/book/price". Elements on a path and their
+    /// ancestors are built, a path ending in an element keeps that element's whole subtree and one ending in @name (or @*)
+    /// keeps just those attributes. Steps may be * to match any name. Everything else is jumped over to its close tag
+    /// without collecting names, attributes or text, see Parser::SetProjection.
+    /// </summary>
+    class Projection
+    {
+    public:
+        Projection() = default;
+        Projection(initializer_list<string_view> paths);
+
+        // false, with Error() describing why, when the path is malformed
+        bool            Add(string_view path);
+
+        bool            IsValid() const { return p_Error.empty(); }
+        const string&   Error() const { return p_Error; }
+
+        struct Node
+        {
+            // empty for the * wildcard
+            string                  Name;
+            // the element was named by a path, everything below it is kept
+            bool                    Whole = false;
+            bool                    AllAttributes = false;
+            vector<string>          Attributes;
+            vector<unique_ptr<Node>> Children;
+
+            // node for a child element called name, null when that child is not needed
+            const Node*             Child(string_view name) const;
+            bool                    KeepsAttribute(string_view key) const;
+        };
+
+        // stands for the document, its children are the root elements paths start with
+        const Node&     Root() const { return p_Root; }
+
+    protected:
+        Node            p_Root;
+        string          p_Error;
+    };
+
+    /// <summary>
+    /// Receives elements, attributes and values as the parser encounters them, no tree is built.
+    /// Views handed to the handler point into the source being parsed.
+    /// </summary>
+    struct IParseHandler
+    {
+        virtual void    OnStartElement(string_view name, Element::Type elementType) = 0;
+        virtual void    OnAttribute(string_view key, string_view value) = 0;
+        virtual void    OnText(string_view value) = 0;
+        virtual void    OnEndElement(string_view name) = 0;
+
+        virtual ~IParseHandler() {};
+    };
+
+    /// <summary>
+    /// Assembles parse events into an owning Document
+    /// </summary>
+    class DocumentBuilder : public IParseHandler
+    {
+    public:
+        Document Doc;
+
+        // takes the elements of doc apart, later documents are built from their strings and vectors
+        void            Recycle(Document& doc);
+
+        virtual void    OnStartElement(string_view name, Element::Type elementType) override;
+        virtual void    OnAttribute(string_view key, string_view value) override;
+        virtual void    OnText(string_view value) override;
+        virtual void    OnEndElement(string_view name) override;
+
+    protected:
+        struct Frame
+        {
+            Element Node;
+            size_t  AttributeCount;
+        };
+
+        vector<Frame>   p_ElementStack;
+        // emptied elements, their buffers keep the capacity they had
+        vector<Element> p_Spare;
+
+        void            RecycleElement(Element& e);
+    };
+
+    class Parser;
+
+    /// <summary>
+    /// Assembles parse events into the NodeArena of a DocumentView
+    /// </summary>
+    class DocumentViewBuilder : public IParseHandler
+    {
+    public:
+        // with a parser, each node records the bytes of nodes.Source it came from
+        DocumentViewBuilder(NodeArena& nodes, const Parser* parser = nullptr);
+
+        virtual void    OnStartElement(string_view name, Element::Type elementType) override;
+        virtual void    OnAttribute(string_view key, string_view value) override;
+        virtual void    OnText(string_view value) override;
+        virtual void    OnEndElement(string_view name) override;
+
+    protected:
+        NodeArena&      p_Nodes;
+        const Parser*   p_Parser;
+        stack<uint32_t> p_NodeStack;
+
+        bool            InSource(string_view value) const;
+    };
+
+    struct ITraceListener;
+    struct ISource;
+
+    class Parser
+    {
+    public:
+        Parser();
+        Document        GetFromString(string& xml);
+        // parses into doc, building the new tree from the elements and strings doc held before
+        void            GetFromString(string_view xml, Document& doc);
+        DocumentView    GetViewFromString(string_view xml, shared_ptr<const void> sourceOwner = nullptr);
+        void            Parse(string_view xml, IParseHandler& handler);
+        // reads source to the end in chunks, the input never has to be in memory as a whole
+        void            Parse(ISource& source, IParseHandler& handler);
+        void            GetFromSource(ISource& source, Document& doc);
+        string          ToString(Document& xml);
+
+        // DocumentViews produced by this parser intern their names into the given table instead of a fresh one each
+        void            SetNameTable(shared_ptr<NameTable> names) { p_Names = std::move(names); }
+        // restricts following parses to the projection's paths, null parses everything again. Not owned, keep it alive while set
+        void            SetProjection(const Projection* projection) { p_Projection = projection; }
+
+        /// <summary>
+        /// Incremental parsing, Feed may be called any number of times with arbitrary chunk boundaries.
+        /// Views handed to the handler are only valid for the duration of the callback.
+        /// </summary>
+        void            Begin(IParseHandler& handler);
+        void            Feed(const char* data, size_t size);
+        void            Finish();
+
+        // next character of the window being parsed, inside the caller's buffer unless a token straddled chunks
+        const char*         Cursor() const { return p_Source.data() + p_Position; }
+
+        // statistics of the current or last parse, see NXML_TRACE
+        const ParseStats&   Stats() const { return p_Stats; }
+        void                SetTraceListener(ITraceListener* listener) { p_TraceListener = listener; }
+
+        enum class Mode
+        {
+            Declaration,
+            WaitForElementOpen,
+            ElementOpen,
+            WaitForAttribute,
+            ElementAttributeName,
+            ElementAttributeValue,
+            ElementClose,
+            GetInnerElementType,
+            ElementValue,
+            // inside a subtree the projection does not need, scanning for its close tag
+            SkipElement,
+        };
+
+        static const char* GetModeName(Mode mode);
+
+    protected:
+        friend class Reader;
+
+        /// <summary>
+        /// Run of characters within p_Source, grown one character at a time by the state machine
+        /// </summary>
+        struct Span
+        {
+            size_t Begin = 0;
+            size_t Length = 0;
+
+            void        Append(size_t index);
+            void        Clear() { Begin = 0; Length = 0; }
+        };
+
+        struct PendingAttribute
+        {
+            Span Key;
+            Span Value;
+        };
+
+        Mode p_Mode;
+        IParseHandler* p_Handler;
+
+        // window being parsed, either the caller's chunk or p_Carry when a token straddles chunks
+        string_view p_Source;
+        string p_Carry;
+        shared_ptr<NameTable> p_Names;
+        size_t p_Position;
+
+        Span p_ElementNameSpan;
+        Span p_ElementValueSpan;
+        Span p_AttributeNameSpan;
+        Span p_AttributeValueSpan;
+        char p_AttributeQuote;
+        char p_PreviousChar;
+
+        vector<PendingAttribute> p_PendingAttributes;
+
+        // decoded copies of values holding references, only valid until the next batch of events
+        string p_Decoded;
+
+        // names of open elements, kept in one buffer so they outlive the window they were parsed from
+        string p_OpenElementNames;
+        vector<size_t> p_OpenElementOffsets;
+
+        // kept between parses so its stack and spare elements keep their capacity
+        DocumentBuilder p_DocumentBuilder;
+
+        const Projection* p_Projection;
+        // projection node of every open element, and of the element whose start tag is being read
+        vector<const Projection::Node*> p_ProjectionStack;
+        const Projection::Node* p_ProjectedNode;
+
+        enum class SkipState
+        {
+            Content,
+            TagStart,
+            Tag,
+            Quote
+        };
+
+        enum class SkipTag
+        {
+            Open,
+            Close,
+            Other
+        };
+
+        // position within the skipped subtree, kept across chunks
+        SkipState p_SkipState;
+        SkipTag p_SkipTag;
+        size_t p_SkipDepth;
+        char p_SkipPrevious;
+        char p_SkipQuote;
+
+        ParseStats p_Stats;
+        ITraceListener* p_TraceListener;
+        chrono::steady_clock::time_point p_ParseStart;
+        chrono::steady_clock::time_point p_ModeStart;
+
+        string_view GetSpan(const Span& span) const;
+        // the span itself when it has no references, otherwise its decoded copy in p_Decoded
+        string_view GetDecodedSpan(const Span& span);
+
+        void SetWindow(const char* data, size_t size);
+        bool Step();
+        void SkipRun();
+        void Rebase();
+
+        // looks the element whose name was just read up in the projection, false when it is not needed
+        bool Project();
+        void BeginSkip(size_t charIndex);
+        // consumes the skipped subtree up to and including its close tag, returns how much of data was used
+        size_t SkipSubtree(const char* data, size_t size);
+
+        void SwitchMode(Mode newMode, char current);
+        void ProcessCharacter(size_t charIndex);
+
+        void CreateElement(Element::Type elementType = Element::Type::Invalid);
+        void CloseElement();
+        void AssignElementValue();
+        void CreateAttribute();
+
+        void ClearCurrentElement();
+        void ClearCurrentAttribute();
+    };
+
+    /// <summary>
+    /// Instrumentation hooks, called only when built with NXML_TRACE enabled.
+    /// OnModeSwitch needs NXML_TRACE 2, it fires for every state machine transition.
+    /// </summary>
+    struct ITraceListener
+    {
+        virtual void    OnModeSwitch(Parser::Mode /* from */, Parser::Mode /* to */, char /* current */) {}
+        virtual void    OnParseComplete(const ParseStats& /* stats */) {}
+
+        virtual ~ITraceListener() {};
+    };
+
+    /// <summary>
+    /// Writes transitions and a statistics summary to a stream, for debugging the state machine
+    /// </summary>
+    class StreamTraceListener : public ITraceListener
+    {
+    public:
+        StreamTraceListener(ostream& stream) : p_Stream(stream) {}
+
+        virtual void    OnModeSwitch(Parser::Mode from, Parser::Mode to, char current) override;
+        virtual void    OnParseComplete(const ParseStats& stats) override;
+
+    protected:
+        ostream& p_Stream;
+    };
+
+    /// <summary>
+    /// Pull interface over the parser, each call to Next yields the following token. Tokens stay valid until the next call.
+    /// Reading from an ISource only holds one chunk and the token being read, so memory stays constant whatever the input size.
+    /// </summary>
+    class Reader : protected IParseHandler
+    {
+    public:
+        enum class TokenType
+        {
+            StartElement,
+            Attribute,
+            Text,
+            EndElement
+        };
+
+        struct Token
+        {
+            TokenType       Type;
+            Element::Type   ElementType;
+            string_view     Name;
+            string_view     Value;
+        };
+
+        Reader(string_view xml);
+        // source is read in chunks as tokens are pulled, keep it alive while reading
+        Reader(ISource& source);
+
+        bool    Next(Token& token);
+
+    protected:
+        Parser              p_Parser;
+        vector<Token>       p_Tokens;
+        size_t              p_NextToken;
+        bool                p_Finished;
+
+        // null when reading a whole buffer
+        ISource*            p_Source;
+        unique_ptr<char[]>  p_Chunk;
+
+        // start tag names point into the source, unlike the parser's own which only last for the callback
+        vector<string_view> p_OpenElements;
+        // with an ISource the chunk a start tag was read from is gone by its end tag, end names are copied instead
+        deque<string>       p_EndNames;
+
+        virtual void    OnStartElement(string_view name, Element::Type elementType) override;
+        virtual void    OnAttribute(string_view key, string_view value) override;
+        virtual void    OnText(string_view value) override;
+        virtual void    OnEndElement(string_view name) override;
+    };
+
+    /// <summary>
+    /// Destination for serialized output
+    /// </summary>
+    struct ISink
+    {
+        virtual void    Write(const char* data, size_t size) = 0;
+        virtual void    Flush() {}
+        // completes the output, compressing sinks write their trailer here. Nothing may be written afterwards
+        virtual void    Finish() { Flush(); }
+        // set once written data could not be encoded, later writes are dropped
+        virtual bool    Failed() const { return false; }
+
+        virtual ~ISink() {};
+    };
+
+    /// <summary>
+    /// Appends to a caller-owned string, reserve it up front to avoid regrowth
+    /// </summary>
+    class StringSink : public ISink
+    {
+    public:
+        StringSink(string& target) : p_Target(target) {}
+
+        virtual void    Write(const char* data, size_t size) override { p_Target.append(data, size); }
+
+    protected:
+        string& p_Target;
+    };
+
+    class StreamSink : public ISink
+    {
+    public:
+        StreamSink(ostream& stream) : p_Stream(stream) {}
+
+        virtual void    Write(const char* data, size_t size) override { p_Stream.write(data, static_cast<streamsize>(size)); }
+        virtual void    Flush() override { p_Stream.flush(); }
+
+    protected:
+        ostream& p_Stream;
+    };
+
+    /// <summary>
+    /// Collects writes into a fixed buffer and hands them on in large blocks
+    /// </summary>
+    class BufferedSink : public ISink
+    {
+    public:
+        BufferedSink(size_t bufferSize = 64 * 1024);
+
+        virtual void    Write(const char* data, size_t size) override;
+        virtual void    Flush() override;
+
+    protected:
+        unique_ptr<char[]>  p_Buffer;
+        size_t              p_Capacity;
+        size_t              p_Used;
+
+        virtual void    WriteOut(const char* data, size_t size) = 0;
+    };
+
+    class FileSink : public BufferedSink
+    {
+    public:
+        FileSink(FILE* file) : p_File(file) {}
+        ~FileSink() { Flush(); }
+
+    protected:
+        FILE* p_File;
+
+        virtual void    WriteOut(const char* data, size_t size) override;
+    };
+
+    class FdSink : public BufferedSink
+    {
+    public:
+        FdSink(int fd) : p_Fd(fd) {}
+        ~FdSink() { Flush(); }
+
+    protected:
+        int p_Fd;
+
+        virtual void    WriteOut(const char* data, size_t size) override;
+    };
+
+    /// <summary>
+    /// Input read in chunks, the counterpart of ISink
+    /// </summary>
+    struct ISource
+    {
+        // fills up to size bytes of data and returns how many, 0 once the input is exhausted
+        virtual size_t  Read(char* data, size_t size) = 0;
+        // set when the input ended early because it could not be read or decoded
+        virtual bool    Failed() const { return false; }
+
+        virtual ~ISource() {};
+    };
+
+    class MemorySource : public ISource
+    {
+    public:
+        MemorySource(string_view data) : p_Data(data) {}
+
+        virtual size_t  Read(char* data, size_t size) override;
+
+    protected:
+        string_view p_Data;
+    };
+
+    class StreamSource : public ISource
+    {
+    public:
+        StreamSource(istream& stream) : p_Stream(stream) {}
+
+        virtual size_t  Read(char* data, size_t size) override;
+        virtual bool    Failed() const override { return p_Stream.bad(); }
+
+    protected:
+        istream& p_Stream;
+    };
+
+    /// <summary>
+    /// Reads the wrapped source on a background thread into a few blocks ahead of the consumer,
+    /// so decompressing the input overlaps with parsing it
+    /// </summary>
+    class AsyncSource : public ISource
+    {
+    public:
+        AsyncSource(ISource& source, size_t blockSize = 256 * 1024, size_t blockCount = 4);
+        ~AsyncSource();
+
+        AsyncSource(const AsyncSource&) = delete;
+        AsyncSource& operator=(const AsyncSource&) = delete;
+
+        virtual size_t  Read(char* data, size_t size) override;
+        virtual bool    Failed() const override { return p_Source.Failed(); }
+
+    protected:
+        ISource&            p_Source;
+        size_t              p_BlockSize;
+        size_t              p_BlockCount;
+        // blocks filled by the reader thread, the front one is being consumed from p_Offset
+        deque<string>       p_Ready;
+        vector<string>      p_Free;
+        size_t              p_Offset;
+        bool                p_Finished;
+        bool                p_Stopping;
+        mutex               p_Mutex;
+        condition_variable  p_Changed;
+        thread              p_Thread;
+
+        void    ReadLoop();
+    };
+
+    /// <summary>
+    /// Hands writes to the wrapped sink on a background thread in blocks, so compressing the output
+    /// overlaps with serializing it. Flush waits for everything handed over to reach the sink.
+    /// </summary>
+    class AsyncSink : public ISink
+    {
+    public:
+        AsyncSink(ISink& sink, size_t blockSize = 256 * 1024, size_t blockCount = 4);
+        ~AsyncSink();
+
+        AsyncSink(const AsyncSink&) = delete;
+        AsyncSink& operator=(const AsyncSink&) = delete;
+
+        virtual void    Write(const char* data, size_t size) override;
+        virtual void    Flush() override;
+
+    protected:
+        ISink&              p_Sink;
+        size_t              p_BlockSize;
+        size_t              p_BlockCount;
+        // block being filled by Write, handed over once full
+        string              p_Current;
+        deque<string>       p_Ready;
+        vector<string>      p_Free;
+        bool                p_Writing;
+        bool                p_Stopping;
+        mutex               p_Mutex;
+        condition_variable  p_Changed;
+        thread              p_Thread;
+
+        void    HandOver();
+        void    WriteLoop();
+    };
+
+    enum class Compression
+    {
+        None,
+        Gzip,
+        Zstd
+    };
+
+    // compression a file's leading bytes announce, None when they are not a known magic number
+    static Compression DetectCompression(string_view head);
+    // compression implied by a path's extension, .gz or .zst
+    static Compression CompressionForPath(const char* path);
+    // decompressing reader over source, or null when support for that format was not compiled in (NXML_ZLIB, NXML_ZSTD)
+    static unique_ptr<ISource> OpenDecompressor(ISource& source, Compression compression);
+    // compressing writer over sink, or null when support for that format was not compiled in
+    static unique_ptr<ISink> OpenCompressor(ISink& sink, Compression compression);
+
+#if NXML_ZLIB
+    /// <summary>
+    /// Inflates gzip (or zlib) data read from the wrapped source, concatenated gzip members are read as one stream
+    /// </summary>
+    class GzipSource : public ISource
+    {
+    public:
+        GzipSource(ISource& source);
+        ~GzipSource();
+
+        GzipSource(const GzipSource&) = delete;
+        GzipSource& operator=(const GzipSource&) = delete;
+
+        virtual size_t  Read(char* data, size_t size) override;
+        virtual bool    Failed() const override { return p_Failed || p_Source.Failed(); }
+
+    protected:
+        ISource&            p_Source;
+        z_stream            p_Stream;
+        unique_ptr<char[]>  p_Input;
+        bool                p_InputEnded;
+        bool                p_Finished;
+        bool                p_Failed;
+    };
+
+    /// <summary>
+    /// Deflates everything written into gzip format. Flush emits a sync point, the stream is completed by Finish or the destructor.
+    /// </summary>
+    class GzipSink : public ISink
+    {
+    public:
+        GzipSink(ISink& sink, int level = Z_DEFAULT_COMPRESSION);
+        ~GzipSink();
+
+        GzipSink(const GzipSink&) = delete;
+        GzipSink& operator=(const GzipSink&) = delete;
+
+        virtual void    Write(const char* data, size_t size) override;
+        virtual void    Flush() override;
+        virtual bool    Failed() const override { return p_Failed || p_Sink.Failed(); }
+        virtual void    Finish() override;
+
+    protected:
+        ISink&              p_Sink;
+        z_stream            p_Stream;
+        unique_ptr<char[]>  p_Output;
+        bool                p_Finished;
+        bool                p_Failed;
+
+        void    Deflate(const char* data, size_t size, int flush);
+    };
+#endif
+
+#if NXML_ZSTD
+    class ZstdSource : public ISource
+    {
+    public:
+        ZstdSource(ISource& source);
+        ~ZstdSource();
+
+        ZstdSource(const ZstdSource&) = delete;
+        ZstdSource& operator=(const ZstdSource&) = delete;
+
+        virtual size_t  Read(char* data, size_t size) override;
+        virtual bool    Failed() const override { return p_Failed || p_Source.Failed(); }
+
+    protected:
+        ISource&            p_Source;
+        ZSTD_DStream*       p_Stream;
+        unique_ptr<char[]>  p_Input;
+        size_t              p_InputSize;
+        ZSTD_inBuffer       p_Pending;
+        bool                p_InputEnded;
+        bool                p_FrameEnded;
+        bool                p_Failed;
+    };
+
+    /// <summary>
+    /// Compresses everything written into a zstd frame. Flush ends the current block, the frame is completed by Finish or the destructor.
+    /// </summary>
+    class ZstdSink : public ISink
+    {
+    public:
+        ZstdSink(ISink& sink, int level = 3);
+        ~ZstdSink();
+
+        ZstdSink(const ZstdSink&) = delete;
+        ZstdSink& operator=(const ZstdSink&) = delete;
+
+        virtual void    Write(const char* data, size_t size) override;
+        virtual void    Flush() override;
+        virtual bool    Failed() const override { return p_Failed || p_Sink.Failed(); }
+        virtual void    Finish() override;
+
+    protected:
+        ISink&              p_Sink;
+        ZSTD_CStream*       p_Stream;
+        unique_ptr<char[]>  p_Output;
+        size_t              p_OutputSize;
+        bool                p_Finished;
+        bool                p_Failed;
+
+        void    Compress(const char* data, size_t size, ZSTD_EndDirective mode);
+    };
+#endif
+
+    /// <summary>
+    /// Writes a whole tree to a sink in a single pass, applying the whitespace policy as it goes
+    /// </summary>
+    class Serializer
+    {
+    public:
+        enum class WhiteSpace
+        {
+            // values are written exactly as stored
+            Preserve,
+            // drops \r, \n and \t from values and collapses runs of spaces to one
+            Collapse,
+            // DocumentViews are written as their source text, only subtrees edited since parsing are regenerated.
+            // Everything else is written as with Preserve
+            Original
+        };
+
+        Serializer(ISink& sink, WhiteSpace whiteSpace = WhiteSpace::Collapse);
+        ~Serializer();
+
+        void    Write(const Document& doc);
+        void    Write(const Element& element);
+        void    Write(const DocumentView& doc);
+        void    Write(ElementView element);
+        void    Flush();
+
+    protected:
+        ISink&      p_Sink;
+        WhiteSpace  p_WhiteSpace;
+        size_t      p_Used;
+        char        p_Buffer[16 * 1024];
+
+        // source of the DocumentView being written in Original mode
+        string_view p_Source;
+
+        void    Put(char c);
+        void    Put(string_view text);
+        void    PutText(string_view text);
+        void    WriteOriginal(ElementView element);
+        // writes children with the source between them, from and to bound that source, npos when there is none
+        void    WriteOriginalChildren(ElementRange children, size_t from, size_t to);
+    };
+
+    /// <summary>
+    /// Forward-only writer that produces XML straight into a sink without building Elements. Only the names of
+    /// the currently open elements are kept, so memory follows the nesting depth rather than the output size.
+    /// Debug builds assert that calls are well formed: attributes right after StartElement, balanced tags.
+    /// </summary>
+    class XmlWriter
+    {
+    public:
+        XmlWriter(ISink& sink, bool declaration = true);
+        ~XmlWriter();
+
+        XmlWriter(const XmlWriter&) = delete;
+        XmlWriter& operator=(const XmlWriter&) = delete;
+
+        void    StartElement(string_view name);
+        // closes the innermost open element
+        void    EndElement();
+        // name is checked against the open element in debug builds
+        void    EndElement(string_view name);
+
+        void    Attribute(string_view key, string_view value);
+        void    Attribute(string_view key, const Date& value) { Attribute(key, string_view(value.ToString())); }
+        template <typename T>
+        typename std::enable_if<std::is_arithmetic<T>::value>::type Attribute(string_view key, T value)
+        {
+            char buffer[64];
+            Attribute(key, FormatValue(buffer, sizeof(buffer), value));
+        }
+
+        void    Text(string_view value);
+        void    Text(const Date& value) { Text(string_view(value.ToString())); }
+        template <typename T>
+        typename std::enable_if<std::is_arithmetic<T>::value>::type Text(T value)
+        {
+            char buffer[64];
+            Text(FormatValue(buffer, sizeof(buffer), value));
+        }
+
+        // StartElement, Text and EndElement in one call
+        template <typename T>
+        void    TextElement(string_view name, const T& value)
+        {
+            StartElement(name);
+            Text(value);
+            EndElement();
+        }
+
+        size_t  Depth() const { return p_Open.size(); }
+        // hands everything written so far to the sink, an open start tag stays buffered
+        void    Flush();
+
+    protected:
+        ISink&          p_Sink;
+        // names of the open elements back to back, p_Open holds where each one starts
+        string          p_Names;
+        vector<size_t>  p_Open;
+        // the last start tag still takes attributes, its '>' is not written yet
+        bool            p_TagOpen;
+        bool            p_HasContent;
+        bool            p_HasRoot;
+        size_t          p_Used;
+        char            p_Buffer[16 * 1024];
+
+        void    CloseTag();
+        void    Put(char c);
+        void    Put(string_view text);
+        void    PutText(string_view text);
+
+        static string_view FormatValue(char* /* buffer */, size_t /* size */, bool value) { return value ? "true" : "false"; }
+        template <typename T>
+        static string_view FormatValue(char* buffer, size_t size, T value)
+        {
+            auto result = std::to_chars(buffer, buffer + size, value);
+            return string_view(buffer, static_cast<size_t>(result.ptr - buffer));
+        }
+    };
+
+    /// <summary>
+    /// Read-only contents of a whole file. Memory mapped where the platform allows it,
+    /// otherwise (pipes, special files, failed mappings) read into memory.
+    /// </summary>
+    class MappedFile
+    {
+    public:
+        MappedFile(const char* path);
+        ~MappedFile();
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        bool        IsValid() const { return p_Valid; }
+        bool        IsMapped() const { return p_Mapped; }
+        const char* Data() const { return p_Data; }
+        size_t      Size() const { return p_Size; }
+        string_view View() const { return string_view(p_Data, p_Size); }
+
+    protected:
+        const char* p_Data;
+        size_t      p_Size;
+        bool        p_Valid;
+        bool        p_Mapped;
+
+        // platform mapping handle, only used on Windows
+        void*       p_MappingHandle;
+        string      p_Buffer;
+
+        void        ReadFallback(const char* path);
+    };
+
+    /// <summary>
+    /// Fixed set of worker threads, each with its own task queue. Tasks submitted from a worker go to that
+    /// worker's queue and run newest first, other tasks are spread round robin, and idle workers steal the
+    /// oldest task from the other queues.
+    /// </summary>
+    class ThreadPool
+    {
+    public:
+        // 0 uses one thread per hardware thread
+        ThreadPool(size_t threadCount = 0);
+        ~ThreadPool();
+
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+        size_t          ThreadCount() const { return p_Threads.size(); }
+        future<void>    Submit(function<void()> task);
+
+        // true on one of this pool's worker threads
+        bool            IsWorkerThread() const;
+        // runs one queued task on the calling thread, false when none was queued. A worker waiting on tasks of its own
+        // pool helps like this rather than blocking, otherwise the tasks could be queued behind the waiting worker forever
+        bool            RunPendingTask();
+        // waits for every future, rethrowing the first exception only once all of them have finished
+        void            WaitAll(vector<future<void>>& futures);
+
+        static ThreadPool& Shared();
+
+    protected:
+        struct WorkerQueue
+        {
+            mutex                           Mutex;
+            deque<packaged_task<void()>>    Tasks;
+        };
+
+        vector<thread>                  p_Threads;
+        vector<unique_ptr<WorkerQueue>> p_Queues;
+        atomic<size_t>                  p_Pending;
+        atomic<size_t>                  p_NextQueue;
+
+        // only used to sleep and wake idle workers
+        mutex                           p_Mutex;
+        condition_variable              p_TaskAvailable;
+        bool                            p_Stopping;
+
+        bool TryPop(size_t worker, packaged_task<void()>& task);
+        void WorkerLoop(size_t worker);
+    };
+
+    /// <summary>
+    /// Outcome of one file of a batch. Doc is left empty when Error is set.
+    /// </summary>
+    struct BatchResult
+    {
+        string      Path;
+        Document    Doc;
+        string      Error;
+        uint64_t    Bytes = 0;
+        // opening and mapping the file, then parsing it (page faults on the mapping included)
+        double      ReadSeconds = 0.0;
+        double      ParseSeconds = 0.0;
+
+        bool        Ok() const { return Error.empty(); }
+    };
+
+    /// <summary>
+    /// Totals over a batch, the per file timings summed up
+    /// </summary>
+    struct BatchStats
+    {
+        size_t      Files = 0;
+        size_t      Failed = 0;
+        uint64_t    Bytes = 0;
+        double      Seconds = 0.0;
+        double      ReadSeconds = 0.0;
+        double      ParseSeconds = 0.0;
+        double      SlowestFileSeconds = 0.0;
+        string      SlowestFile;
+
+        string      ToString() const;
+    };
+
+    struct BatchOptions
+    {
+        // files are only started while the bytes of unfinished ones stay below this, a larger file runs on its own
+        uint64_t    MaxInFlightBytes = 256ull * 1024 * 1024;
+        // ThreadPool::Shared() when null
+        ThreadPool* Pool = nullptr;
+        // ParseDirectory only
+        string      Extension = ".xml";
+        bool        Recursive = true;
+    };
+
+    // called on the thread that called ParseFiles, one result at a time, in completion order. The result may be moved from
+    using BatchConsumer = function<void(BatchResult& result)>;
+
+    /// <summary>
+    /// Compiled form of an XSD subset: global xs:element, named or anonymous xs:complexType holding an
+    /// xs:sequence of elements with min/maxOccurs, xs:attribute with use, and simple types
+    /// xs:string, xs:float, xs:double, xs:int/xs:integer, xs:boolean and xs:date
+    /// </summary>
+    class Schema
+    {
+    public:
+        static constexpr uint32_t Unbounded = UINT32_MAX;
+
+        enum class SimpleType
+        {
+            String,
+            Float,
+            Double,
+            Integer,
+            Boolean,
+            Date
+        };
+
+        struct AttributeDecl
+        {
+            string      Name;
+            SimpleType  Type = SimpleType::String;
+            bool        Required = false;
+        };
+
+        struct ElementDecl
+        {
+            string      Name;
+            // index into ComplexTypes, or -1 for simple content of Type
+            int         ComplexType = -1;
+            SimpleType  Type = SimpleType::String;
+            uint32_t    MinOccurs = 1;
+            uint32_t    MaxOccurs = 1;
+        };
+
+        struct ComplexType
+        {
+            string                  Name;
+            vector<ElementDecl>     Sequence;
+            vector<AttributeDecl>   Attributes;
+        };
+
+        vector<ElementDecl> RootElements;
+        vector<ComplexType> ComplexTypes;
+        // problems found while loading, the schema should not be used unless this is empty
+        vector<string>      Errors;
+
+        static Schema   FromString(string_view xsd);
+        static Schema   FromFile(const char* path);
+
+        bool            IsValid() const { return Errors.empty(); }
+        static bool     IsValidValue(SimpleType type, string_view value);
+        static string   GetTypeName(SimpleType type);
+
+    protected:
+        string p_Prefix;
+
+        string_view LocalName(string_view name) const;
+        bool        ResolveType(string_view typeName, const vector<string>& complexNames, ElementDecl& decl);
+        int         CompileComplexType(const Element& element, const string& name, const vector<string>& complexNames);
+        bool        CompileElement(const Element& element, const vector<string>& complexNames, ElementDecl& decl);
+    };
+
+    struct ValidationError
+    {
+        // slash separated element path, e.g. catalog/book/price
+        string Path;
+        string Message;
+    };
+
+    /// <summary>
+    /// Checks events against a Schema as they are parsed, optionally forwarding them to another handler
+    /// (e.g. a DocumentBuilder) so validation and tree building happen in the same pass
+    /// </summary>
+    class ValidatingHandler : public IParseHandler
+    {
+    public:
+        ValidatingHandler(const Schema& schema, IParseHandler* next = nullptr);
+
+        bool                            IsValid() const { return p_Errors.empty(); }
+        const vector<ValidationError>&  Errors() const { return p_Errors; }
+
+        virtual void    OnStartElement(string_view name, Element::Type elementType) override;
+        virtual void    OnAttribute(string_view key, string_view value) override;
+        virtual void    OnText(string_view value) override;
+        virtual void    OnEndElement(string_view name) override;
+
+    protected:
+        struct Frame
+        {
+            const Schema::ElementDecl*  Decl;
+            size_t                      Particle;
+            uint32_t                    Count;
+            uint64_t                    SeenAttributes;
+            size_t                      PathLength;
+            bool                        HasText;
+        };
+
+        const Schema&           p_Schema;
+        IParseHandler*          p_Next;
+        vector<Frame>           p_Frames;
+        string                  p_Path;
+        vector<ValidationError> p_Errors;
+
+        void                        AddError(string message);
+        const Schema::ComplexType*  TypeOf(const Frame& frame) const;
+        const Schema::ElementDecl*  MatchChild(Frame& parent, string_view name);
+        void                        CheckSequenceComplete(Frame& frame);
+    };
+
+    /// <summary>
+    /// Type-erased destination for parse events while loading straight into a user type, see NXML_DEFINE_TYPE.
+    /// Child resolves a child element or attribute name to the binding of the matching member.
+    /// </summary>
+    struct Binding
+    {
+        void* Target = nullptr;
+        // false when the text is not a valid value for the target
+        bool (*Text)(void* target, string_view value) = nullptr;
+        bool (*Child)(void* target, string_view name, Binding& out) = nullptr;
+    };
+
+    /// <summary>
+    /// Routes parse events into a tree of Bindings, no Element is built. Elements and attributes
+    /// without a matching member are skipped along with everything below them.
+    /// </summary>
+    class BindingHandler : public IParseHandler
+    {
+    public:
+        BindingHandler(Binding root);
+
+        bool            BoundRoot() const { return p_BoundRoot; }
+        // element texts and attribute values that could not be decoded into their member, which kept its previous value
+        size_t          InvalidValues() const { return p_InvalidValues; }
+
+        virtual void    OnStartElement(string_view name, Element::Type elementType) override;
+        virtual void    OnAttribute(string_view key, string_view value) override;
+        virtual void    OnText(string_view value) override;
+        virtual void    OnEndElement(string_view name) override;
+
+    protected:
+        Binding         p_Root;
+        vector<Binding> p_Stack;
+        bool            p_BoundRoot = false;
+        size_t          p_InvalidValues = 0;
+    };
+
+    template <typename T>
+    struct TypeBinder
+    {
+        static bool Text(void* target, string_view value)
+        {
+            if constexpr (IsValueType<T>::value) return ReadValue(value, *static_cast<T*>(target));
+            else return true;
+        }
+
+        static bool Child(void* target, string_view name, Binding& out)
+        {
+            // NxmlBindChild is generated by NXML_DEFINE_TYPE next to the user type and found through ADL
+            if constexpr (IsValueType<T>::value) return false;
+            else return NxmlBindChild(*static_cast<T*>(target), name, out);
+        }
+    };
+
+    template <typename T>
+    Binding Bind(T& value)
+    {
+        return Binding{ &value, &TypeBinder<T>::Text, &TypeBinder<T>::Child };
+    }
+
+    template <typename T>
+    void BindMember(T& member, Binding& out)
+    {
+        out = Bind(member);
+    }
+
+    // every occurrence of a repeated element appends an item
+    template <typename T>
+    void BindMember(vector<T>& member, Binding& out)
+    {
+        member.emplace_back();
+        out = Bind(member.back());
+    }
+
+    template <typename T>
+    void WriteMember(Element& parent, const char* name, const T& value)
+    {
+        if constexpr (IsValueType<T>::value)
+        {
+            Element e(Element::Type::Value);
+            e.ElementName = name;
+            WriteValue(e.InnerValue, value);
+            parent.InnerElements.push_back(std::move(e));
+        }
+        else
+        {
+            Element e(Element::Type::Complex);
+            e.ElementName = name;
+            NxmlToElement(e, value);
+            parent.InnerElements.push_back(std::move(e));
+        }
+    }
+
+    template <typename T>
+    void WriteMember(Element& parent, const char* name, const vector<T>& values)
+    {
+        for (const T& value : values) WriteMember(parent, name, value);
+    }
+
+    // emits the parse events an element and its subtree would have produced
+    static void Replay(const Element& element, IParseHandler& handler);
+
+    /// <summary>
+    /// Converts a type registered with NXML_DEFINE_TYPE (or a plain value) into an element named name
+    /// </summary>
+    template <typename T>
+    static Element ToElement(const T& value, string_view name)
+    {
+        Element holder(Element::Type::Complex);
+        WriteMember(holder, string(name).c_str(), value);
+        return std::move(holder.InnerElements.front());
+    }
+
+    // false when a value could not be decoded, that member keeps what it held
+    template <typename T>
+    static bool FromElement(const Element& element, T& value)
+    {
+        BindingHandler handler(Bind(value));
+        Replay(element, handler);
+        return handler.InvalidValues() == 0;
+    }
+
+    /// <summary>
+    /// Fills value directly from parse events, the root element maps to value itself.
+    /// Returns false when the input has no root element or a value could not be decoded.
+    /// </summary>
+    template <typename T>
+    static bool ParseInto(string_view xml, T& value)
+    {
+        BindingHandler handler(Bind(value));
+        Parser parser;
+        parser.Parse(xml, handler);
+        return handler.BoundRoot() && handler.InvalidValues() == 0;
+    }
+
+    // parser belonging to the calling thread, reused by the parse functions below that take no handler
+    static Parser& ThreadParser();
+
+    static Document ParseString(string& input);
+    // recycles what doc held before, once warmed up parsing similar messages allocates nothing
+    static void ParseString(string_view input, Document& doc);
+    static void ParseString(string_view input, IParseHandler& handler);
+    // splits the root's children into chunks parsed on the pool, the result is identical to ParseString
+    static Document ParseParallel(string_view input, ThreadPool* pool = nullptr);
+    // builds only the elements on the projection's paths and their ancestors, see Projection
+    static Document ParseProjected(string_view input, const Projection& projection);
+    static DocumentView ParseView(string_view input);
+    static DocumentView ParseView(string&& input);
+    // only indexes the structure, elements are decoded as they are navigated to
+    static LazyDocument ParseLazy(string_view input);
+    static LazyDocument ParseLazy(string&& input);
+    // gzip and zstd files (by their magic number) are decompressed on a background thread while being parsed,
+    // damaged or truncated compressed data gives an empty document
+    static Document ParseFile(const char* path);
+    static Document ParseSource(ISource& source);
+    // the returned document keeps the mapping alive for as long as it exists
+    static DocumentView ParseFileView(const char* path);
+    // loads the binary snapshot at cachePath, re-parsing path and rewriting the snapshot when it is stale.
+    // An empty document when path cannot be read, the snapshot is not used then
+    static DocumentView ParseFileCached(const char* path, const char* cachePath);
+    // parses every file on the pool and hands each one to consumer as it completes
+    static BatchStats ParseFiles(const vector<string>& paths, const BatchConsumer& consumer, const BatchOptions& options = BatchOptions());
+    // ParseFiles over the files in directory with options.Extension
+    static BatchStats ParseDirectory(const char* directory, const BatchConsumer& consumer, const BatchOptions& options = BatchOptions());
+    // checks input against the schema without building a tree
+    static bool Validate(string_view input, const Schema& schema, vector<ValidationError>* errors = nullptr);
+    static Document ParseValidated(string_view input, const Schema& schema, vector<ValidationError>& errors);
+    
+    /// <summary>
+    /// Delimiter scanners used to skip over runs of text, attribute values and names.
+    /// The widest instruction set the CPU supports is picked at runtime, define NXML_NO_SIMD to only build the scalar path.
+    /// </summary>
+    namespace simd {
+        enum class Level
+        {
+            Scalar,
+            SSE2,
+            AVX2
+        };
+
+        static Level    DetectLevel();
+        static Level    GetLevel();
+        static void     SetLevel(Level level);
+
+        // index of the first c in data, or size when there is none
+        static size_t   FindChar(const char* data, size_t size, char c);
+        // index of the first '/', '>' or whitespace (any byte <= ' '), or size when there is none
+        static size_t   FindNameEnd(const char* data, size_t size);
+        // index of the first '&', '<', '>' or '"', or size when there is none
+        static size_t   FindEscape(const char* data, size_t size);
+    }
+
+    // appends text to out with entity and character references replaced, malformed ones are kept as written
+    static void DecodeEntities(string_view text, string& out);
+    // appends text to out with &, <, > and " replaced by entity references
+    static void EscapeText(string_view text, string& out);
+
+    namespace utils {
+        static void CleanWhiteSpace(string& input);
+        // gzip and zstd files are decompressed, and saved compressed when the path ends in .gz or .zst
+        static string LoadFileAsString(const char* path);
+        // false when the file cannot be read or its compressed data is damaged or cut off, out is left empty then
+        static bool LoadFileAsString(const char* path, string& out);
+        // false when the file could not be written or compressed, also for a .gz or .zst path when that format was not compiled in
+        static bool SaveStringToFile(const char* path, string& str);
+    }
+
+    // serializes doc into path, compressed on a background thread when path ends in .gz or .zst
+    // false when the file cannot be written or compressed, also for a .gz or .zst path when that format was not compiled in
+    static bool SaveFile(const Document& doc, const char* path, Serializer::WhiteSpace whiteSpace = Serializer::WhiteSpace::Collapse);
+}
+// All credit to https://github.com/nlohmann/json for these hideous helpful macros
+#define NXML_EXPAND(x) x
+#define NXML_GET_MACRO(_1, _2, _3, _4, _5, _6, _7, _8, _9, _10, _11, _12, _13, _14, _15, _16, _17, _18, _19, _20, _21, _22, _23, _24, _25, _26, _27, _28, _29, _30, _31, _32, _33, _34, _35, _36, _37, _38, _39, _40, _41, _42, _43, _44, _45, _46, _47, _48, _49, _50, _51, _52, _53, _54, _55, _56, _57, _58, _59, _60, _61, _62, _63, _64, NAME, ...) NAME
+#define NXML_PASTE(...) NXML_EXPAND(NXML_GET_MACRO(__VA_ARGS__, \
+        NXML_PASTE64, \
+        NXML_PASTE63, \
+        NXML_PASTE62, \
+        NXML_PASTE61, \
+        NXML_PASTE60, \
+        NXML_PASTE59, \
+        NXML_PASTE58, \
+        NXML_PASTE57, \
+        NXML_PASTE56, \
+        NXML_PASTE55, \
+        NXML_PASTE54, \
+        NXML_PASTE53, \
+        NXML_PASTE52, \
+        NXML_PASTE51, \
+        NXML_PASTE50, \
+        NXML_PASTE49, \
+        NXML_PASTE48, \
+        NXML_PASTE47, \
+        NXML_PASTE46, \
+        NXML_PASTE45, \
+        NXML_PASTE44, \
+        NXML_PASTE43, \
+        NXML_PASTE42, \
+        NXML_PASTE41, \
+        NXML_PASTE40, \
+        NXML_PASTE39, \
+        NXML_PASTE38, \
+        NXML_PASTE37, \
+        NXML_PASTE36, \
+        NXML_PASTE35, \
+        NXML_PASTE34, \
+        NXML_PASTE33, \
+        NXML_PASTE32, \
+        NXML_PASTE31, \
+        NXML_PASTE30, \
+        NXML_PASTE29, \
+        NXML_PASTE28, \
+        NXML_PASTE27, \
+        NXML_PASTE26, \
+        NXML_PASTE25, \
+        NXML_PASTE24, \
+        NXML_PASTE23, \
+        NXML_PASTE22, \
+        NXML_PASTE21, \
+        NXML_PASTE20, \
+        NXML_PASTE19, \
+        NXML_PASTE18, \
+        NXML_PASTE17, \
+        NXML_PASTE16, \
+        NXML_PASTE15, \
+        NXML_PASTE14, \
+        NXML_PASTE13, \
+        NXML_PASTE12, \
+        NXML_PASTE11, \
+        NXML_PASTE10, \
+        NXML_PASTE9, \
+        NXML_PASTE8, \
+        NXML_PASTE7, \
+        NXML_PASTE6, \
+        NXML_PASTE5, \
+        NXML_PASTE4, \
+        NXML_PASTE3, \
+        NXML_PASTE2, \
+        NXML_PASTE1)(__VA_ARGS__))
+#define NXML_PASTE2(func, v1) func(v1)
+#define NXML_PASTE3(func, v1, v2) NXML_PASTE2(func, v1) NXML_PASTE2(func, v2)
+#define NXML_PASTE4(func, v1, v2, v3) NXML_PASTE2(func, v1) NXML_PASTE3(func, v2, v3)
+#define NXML_PASTE5(func, v1, v2, v3, v4) NXML_PASTE2(func, v1) NXML_PASTE4(func, v2, v3, v4)
+#define NXML_PASTE6(func, v1, v2, v3, v4, v5) NXML_PASTE2(func, v1) NXML_PASTE5(func, v2, v3, v4, v5)
+#define NXML_PASTE7(func, v1, v2, v3, v4, v5, v6) NXML_PASTE2(func, v1) NXML_PASTE6(func, v2, v3, v4, v5, v6)
+#define NXML_PASTE8(func, v1, v2, v3, v4, v5, v6, v7) NXML_PASTE2(func, v1) NXML_PASTE7(func, v2, v3, v4, v5, v6, v7)
+#define NXML_PASTE9(func, v1, v2, v3, v4, v5, v6, v7, v8) NXML_PASTE2(func, v1) NXML_PASTE8(func, v2, v3, v4, v5, v6, v7, v8)
+#define NXML_PASTE10(func, v1, v2, v3, v4, v5, v6, v7, v8, v9) NXML_PASTE2(func, v1) NXML_PASTE9(func, v2, v3, v4, v5, v6, v7, v8, v9)
+#define NXML_PASTE11(func, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10) NXML_PASTE2(func, v1) NXML_PASTE10(func, v2, v3, v4, v5, v6, v7, v8, v9, v10)
+#define NXML_PASTE12(func, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11) NXML_PASTE2(func, v1) NXML_PASTE11(func, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11)
+#define NXML_PASTE13(func, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12) NXML_PASTE2(func, v1) NXML_PASTE12(func, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12)
+#define NXML_PASTE14(func, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13) NXML_PASTE2(func, v1) NXML_PASTE13(func, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13)
+#define NXML_PASTE15(func, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14) NXML_PASTE2(func, v1) NXML_PASTE14(func, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14)
+#define NXML_PASTE16(func, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15) NXML_PASTE2(func, v1) NXML_PASTE15(func, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15)
+#define NXML_PASTE17(func, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16) NXML_PASTE2(func, v1) NXML_PASTE16(func, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16)
+#define NXML_PASTE18(func, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17) NXML_PASTE2(func, v1) NXML_PASTE17(func, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17)
+#define NXML_PASTE19(func, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18) NXML_PASTE2(func, v1) NXML_PASTE18(func, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18)
+#define NXML_PASTE20(func, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19) NXML_PASTE2(func, v1) NXML_PASTE19(func, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19)
+#define NXML_PASTE21(func, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20) NXML_PASTE2(func, v1) NXML_PASTE20(func, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20)
+#define NXML_PASTE22(func, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21) NXML_PASTE2(func, v1) NXML_PASTE21(func, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21)
+#define NXML_PASTE23(func, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22) NXML_PASTE2(func, v1) NXML_PASTE22(func, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22)
+#define NXML_PASTE24(func, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23) NXML_PASTE2(func, v1) NXML_PASTE23(func, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23)
+#define NXML_PASTE25(func, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24) NXML_PASTE2(func, v1) NXML_PASTE24(func, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24)
+#define NXML_PASTE26(func, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25) NXML_PASTE2(func, v1) NXML_PASTE25(func, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25)
+#define NXML_PASTE27(func, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26) NXML_PASTE2(func, v1) NXML_PASTE26(func, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26)
+#define NXML_PASTE28(func, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27) NXML_PASTE2(func, v1) NXML_PASTE27(func, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27)
+#define NXML_PASTE29(func, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28) NXML_PASTE2(func, v1) NXML_PASTE28(func, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28)
+#define NXML_PASTE30(func, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29) NXML_PASTE2(func, v1) NXML_PASTE29(func, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29)
+#define NXML_PASTE31(func, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30) NXML_PASTE2(func, v1) NXML_PASTE30(func, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30)
+#define NXML_PASTE32(func, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31) NXML_PASTE2(func, v1) NXML_PASTE31(func, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31)
+#define NXML_PASTE33(func, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32) NXML_PASTE2(func, v1) NXML_PASTE32(func, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32)
+#define NXML_PASTE34(func, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33) NXML_PASTE2(func, v1) NXML_PASTE33(func, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33)
+#define NXML_PASTE35(func, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33, v34) NXML_PASTE2(func, v1) NXML_PASTE34(func, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33, v34)
+#define NXML_PASTE36(func, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33, v34, v35) NXML_PASTE2(func, v1) NXML_PASTE35(func, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33, v34, v35)
+#define NXML_PASTE37(func, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33, v34, v35, v36) NXML_PASTE2(func, v1) NXML_PASTE36(func, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33, v34, v35, v36)
+#define NXML_PASTE38(func, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33, v34, v35, v36, v37) NXML_PASTE2(func, v1) NXML_PASTE37(func, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33, v34, v35, v36, v37)
+#define NXML_PASTE39(func, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33, v34, v35, v36, v37, v38) NXML_PASTE2(func, v1) NXML_PASTE38(func, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33, v34, v35, v36, v37, v38)
+#define NXML_PASTE40(func, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33, v34, v35, v36, v37, v38, v39) NXML_PASTE2(func, v1) NXML_PASTE39(func, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33, v34, v35, v36, v37, v38, v39)
+#define NXML_PASTE41(func, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33, v34, v35, v36, v37, v38, v39, v40) NXML_PASTE2(func, v1) NXML_PASTE40(func, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33, v34, v35, v36, v37, v38, v39, v40)
+#define NXML_PASTE42(func, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33, v34, v35, v36, v37, v38, v39, v40, v41) NXML_PASTE2(func, v1) NXML_PASTE41(func, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33, v34, v35, v36, v37, v38, v39, v40, v41)
+#define NXML_PASTE43(func, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33, v34, v35, v36, v37, v38, v39, v40, v41, v42) NXML_PASTE2(func, v1) NXML_PASTE42(func, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33, v34, v35, v36, v37, v38, v39, v40, v41, v42)
+#define NXML_PASTE44(func, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33, v34, v35, v36, v37, v38, v39, v40, v41, v42, v43) NXML_PASTE2(func, v1) NXML_PASTE43(func, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33, v34, v35, v36, v37, v38, v39, v40, v41, v42, v43)
+#define NXML_PASTE45(func, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33, v34, v35, v36, v37, v38, v39, v40, v41, v42, v43, v44) NXML_PASTE2(func, v1) NXML_PASTE44(func, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33, v34, v35, v36, v37, v38, v39, v40, v41, v42, v43, v44)
+#define NXML_PASTE46(func, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33, v34, v35, v36, v37, v38, v39, v40, v41, v42, v43, v44, v45) NXML_PASTE2(func, v1) NXML_PASTE45(func, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33, v34, v35, v36, v37, v38, v39, v40, v41, v42, v43, v44, v45)
+#define NXML_PASTE47(func, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33, v34, v35, v36, v37, v38, v39, v40, v41, v42, v43, v44, v45, v46) NXML_PASTE2(func, v1) NXML_PASTE46(func, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33, v34, v35, v36, v37, v38, v39, v40, v41, v42, v43, v44, v45, v46)
+#define NXML_PASTE48(func, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33, v34, v35, v36, v37, v38, v39, v40, v41, v42, v43, v44, v45, v46, v47) NXML_PASTE2(func, v1) NXML_PASTE47(func, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33, v34, v35, v36, v37, v38, v39, v40, v41, v42, v43, v44, v45, v46, v47)
+#define NXML_PASTE49(func, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33, v34, v35, v36, v37, v38, v39, v40, v41, v42, v43, v44, v45, v46, v47, v48) NXML_PASTE2(func, v1) NXML_PASTE48(func, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33, v34, v35, v36, v37, v38, v39, v40, v41, v42, v43, v44, v45, v46, v47, v48)
+#define NXML_PASTE50(func, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33, v34, v35, v36, v37, v38, v39, v40, v41, v42, v43, v44, v45, v46, v47, v48, v49) NXML_PASTE2(func, v1) NXML_PASTE49(func, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33, v34, v35, v36, v37, v38, v39, v40, v41, v42, v43, v44, v45, v46, v47, v48, v49)
+#define NXML_PASTE51(func, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33, v34, v35, v36, v37, v38, v39, v40, v41, v42, v43, v44, v45, v46, v47, v48, v49, v50) NXML_PASTE2(func, v1) NXML_PASTE50(func, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33, v34, v35, v36, v37, v38, v39, v40, v41, v42, v43, v44, v45, v46, v47, v48, v49, v50)
+#define NXML_PASTE52(func, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33, v34, v35, v36, v37, v38, v39, v40, v41, v42, v43, v44, v45, v46, v47, v48, v49, v50, v51) NXML_PASTE2(func, v1) NXML_PASTE51(func, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33, v34, v35, v36, v37, v38, v39, v40, v41, v42, v43, v44, v45, v46, v47, v48, v49, v50, v51)
+#define NXML_PASTE53(func, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33, v34, v35, v36, v37, v38, v39, v40, v41, v42, v43, v44, v45, v46, v47, v48, v49, v50, v51, v52) NXML_PASTE2(func, v1) NXML_PASTE52(func, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33, v34, v35, v36, v37, v38, v39, v40, v41, v42, v43, v44, v45, v46, v47, v48, v49, v50, v51, v52)
+#define NXML_PASTE54(func, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33, v34, v35, v36, v37, v38, v39, v40, v41, v42, v43, v44, v45, v46, v47, v48, v49, v50, v51, v52, v53) NXML_PASTE2(func, v1) NXML_PASTE53(func, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33, v34, v35, v36, v37, v38, v39, v40, v41, v42, v43, v44, v45, v46, v47, v48, v49, v50, v51, v52, v53)
+#define NXML_PASTE55(func, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33, v34, v35, v36, v37, v38, v39, v40, v41, v42, v43, v44, v45, v46, v47, v48, v49, v50, v51, v52, v53, v54) NXML_PASTE2(func, v1) NXML_PASTE54(func, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33, v34, v35, v36, v37, v38, v39, v40, v41, v42, v43, v44, v45, v46, v47, v48, v49, v50, v51, v52, v53, v54)
+#define NXML_PASTE56(func, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33, v34, v35, v36, v37, v38, v39, v40, v41, v42, v43, v44, v45, v46, v47, v48, v49, v50, v51, v52, v53, v54, v55) NXML_PASTE2(func, v1) NXML_PASTE55(func, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33, v34, v35, v36, v37, v38, v39, v40, v41, v42, v43, v44, v45, v46, v47, v48, v49, v50, v51, v52, v53, v54, v55)
+#define NXML_PASTE57(func, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33, v34, v35, v36, v37, v38, v39, v40, v41, v42, v43, v44, v45, v46, v47, v48, v49, v50, v51, v52, v53, v54, v55, v56) NXML_PASTE2(func, v1) NXML_PASTE56(func, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33, v34, v35, v36, v37, v38, v39, v40, v41, v42, v43, v44, v45, v46, v47, v48, v49, v50, v51, v52, v53, v54, v55, v56)
+#define NXML_PASTE58(func, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33, v34, v35, v36, v37, v38, v39, v40, v41, v42, v43, v44, v45, v46, v47, v48, v49, v50, v51, v52, v53, v54, v55, v56, v57) NXML_PASTE2(func, v1) NXML_PASTE57(func, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33, v34, v35, v36, v37, v38, v39, v40, v41, v42, v43, v44, v45, v46, v47, v48, v49, v50, v51, v52, v53, v54, v55, v56, v57)
+#define NXML_PASTE59(func, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33, v34, v35, v36, v37, v38, v39, v40, v41, v42, v43, v44, v45, v46, v47, v48, v49, v50, v51, v52, v53, v54, v55, v56, v57, v58) NXML_PASTE2(func, v1) NXML_PASTE58(func, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33, v34, v35, v36, v37, v38, v39, v40, v41, v42, v43, v44, v45, v46, v47, v48, v49, v50, v51, v52, v53, v54, v55, v56, v57, v58)
+#define NXML_PASTE60(func, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33, v34, v35, v36, v37, v38, v39, v40, v41, v42, v43, v44, v45, v46, v47, v48, v49, v50, v51, v52, v53, v54, v55, v56, v57, v58, v59) NXML_PASTE2(func, v1) NXML_PASTE59(func, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33, v34, v35, v36, v37, v38, v39, v40, v41, v42, v43, v44, v45, v46, v47, v48, v49, v50, v51, v52, v53, v54, v55, v56, v57, v58, v59)
+#define NXML_PASTE61(func, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33, v34, v35, v36, v37, v38, v39, v40, v41, v42, v43, v44, v45, v46, v47, v48, v49, v50, v51, v52, v53, v54, v55, v56, v57, v58, v59, v60) NXML_PASTE2(func, v1) NXML_PASTE60(func, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33, v34, v35, v36, v37, v38, v39, v40, v41, v42, v43, v44, v45, v46, v47, v48, v49, v50, v51, v52, v53, v54, v55, v56, v57, v58, v59, v60)
+#define NXML_PASTE62(func, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33, v34, v35, v36, v37, v38, v39, v40, v41, v42, v43, v44, v45, v46, v47, v48, v49, v50, v51, v52, v53, v54, v55, v56, v57, v58, v59, v60, v61) NXML_PASTE2(func, v1) NXML_PASTE61(func, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33, v34, v35, v36, v37, v38, v39, v40, v41, v42, v43, v44, v45, v46, v47, v48, v49, v50, v51, v52, v53, v54, v55, v56, v57, v58, v59, v60, v61)
+#define NXML_PASTE63(func, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33, v34, v35, v36, v37, v38, v39, v40, v41, v42, v43, v44, v45, v46, v47, v48, v49, v50, v51, v52, v53, v54, v55, v56, v57, v58, v59, v60, v61, v62) NXML_PASTE2(func, v1) NXML_PASTE62(func, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33, v34, v35, v36, v37, v38, v39, v40, v41, v42, v43, v44, v45, v46, v47, v48, v49, v50, v51, v52, v53, v54, v55, v56, v57, v58, v59, v60, v61, v62)
+#define NXML_PASTE64(func, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33, v34, v35, v36, v37, v38, v39, v40, v41, v42, v43, v44, v45, v46, v47, v48, v49, v50, v51, v52, v53, v54, v55, v56, v57, v58, v59, v60, v61, v62, v63) NXML_PASTE2(func, v1) NXML_PASTE63(func, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23, v24, v25, v26, v27, v28, v29, v30, v31, v32, v33, v34, v35, v36, v37, v38, v39, v40, v41, v42, v43, v44, v45, v46, v47, v48, v49, v50, v51, v52, v53, v54, v55, v56, v57, v58, v59, v60, v61, v62, v63)
+
+
+#define NXML_TO_ELEMENT(member) nxml::WriteMember(nxml_element, #member, nxml_value.member);
+#define NXML_BIND_MEMBER(member) if (nxml_name == #member) { nxml::BindMember(nxml_value.member, nxml_out); return true; }
+
+/// <summary>
+/// Registers the listed members of Type for conversion to and from XML, each member maps to a child element
+/// (or attribute, when reading) of the same name. Place it in the namespace Type is declared in.
+/// </summary>
+#define NXML_DEFINE_TYPE(Type, ...) \
+    inline void NxmlToElement(nxml::Element& nxml_element, const Type& nxml_value) { NXML_EXPAND(NXML_PASTE(NXML_TO_ELEMENT, __VA_ARGS__)) } \
+    inline bool NxmlBindChild(Type& nxml_value, std::string_view nxml_name, nxml::Binding& nxml_out) { NXML_EXPAND(NXML_PASTE(NXML_BIND_MEMBER, __VA_ARGS__)) return false; }
+
+#ifdef NXML_IMPL
+
+#define NXML_ASSERT(exp, msg) assert(((void)msg, exp))
+
+#if NXML_TRACE
+#define NXML_TRACE_STAT(statement) statement
+#else
+#define NXML_TRACE_STAT(statement)
+#endif
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// 0 compiles instrumentation out, 1 collects ParseStats, 2 also reports every state machine transition to the ITraceListener
+#ifndef NXML_TRACE
+#define NXML_TRACE 0
+#endif
+
+#ifdef NXML_SIMD_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define NXML_TARGET_SSE2
+#define NXML_TARGET_AVX2
+#else
+#define NXML_TARGET_SSE2 __attribute__((target("sse2")))
+#define NXML_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+namespace nxml::simd {
+
+    static inline bool IsNameEnd(char c)
+    {
+        return c == '/' || c == '>' || static_cast<unsigned char>(c) <= ' ';
+    }
+
+    static size_t FindCharScalar(const char* data, size_t size, char c)
+    {
+        // memchr needs a valid pointer even for an empty range
+        if (size == 0) return 0;
+        const void* found = std::memchr(data, c, size);
+        return found ? static_cast<size_t>(static_cast<const char*>(found) - data) : size;
+    }
+
+    static size_t FindNameEndScalar(const char* data, size_t size)
+    {
+        for (size_t i = 0; i < size; i++)
+        {
+            if (IsNameEnd(data[i])) return i;
+        }
+        return size;
+    }
+
+    static inline bool IsEscape(char c)
+    {
+        return c == '&' || c == '<' || c == '>' || c == '"';
+    }
+
+    static size_t FindEscapeScalar(const char* data, size_t size)
+    {
+        for (size_t i = 0; i < size; i++)
+        {
+            if (IsEscape(data[i])) return i;
+        }
+        return size;
+    }
+
+#ifdef NXML_SIMD_X86
+    static inline uint32_t CountTrailingZeros(uint32_t mask)
+    {
+#ifdef _MSC_VER
+        unsigned long index;
+        _BitScanForward(&index, mask);
+        return index;
+#else
+        return static_cast<uint32_t>(__builtin_ctz(mask));
+#endif
+    }
+
+    static inline uint32_t CountTrailingZeros64(uint64_t mask)
+    {
+        uint32_t low = static_cast<uint32_t>(mask);
+        return low ? CountTrailingZeros(low) : 32 + CountTrailingZeros(static_cast<uint32_t>(mask >> 32));
+    }
+
+    NXML_TARGET_SSE2 static size_t FindCharSSE2(const char* data, size_t size, char c)
+    {
+        const __m128i needle = _mm_set1_epi8(c);
+        size_t i = 0;
+        // four vectors per iteration, text runs are usually long enough that the unrolled loop dominates
+        for (; i + 64 <= size; i += 64)
+        {
+            __m128i a = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i)), needle);
+            __m128i b = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + 16)), needle);
+            __m128i c0 = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + 32)), needle);
+            __m128i d = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + 48)), needle);
+            if (_mm_movemask_epi8(_mm_or_si128(_mm_or_si128(a, b), _mm_or_si128(c0, d))) == 0) continue;
+
+            uint64_t mask = static_cast<uint64_t>(static_cast<uint32_t>(_mm_movemask_epi8(a)))
+                          | static_cast<uint64_t>(static_cast<uint32_t>(_mm_movemask_epi8(b))) << 16
+                          | static_cast<uint64_t>(static_cast<uint32_t>(_mm_movemask_epi8(c0))) << 32
+                          | static_cast<uint64_t>(static_cast<uint32_t>(_mm_movemask_epi8(d))) << 48;
+            return i + CountTrailingZeros64(mask);
+        }
+        for (; i + 16 <= size; i += 16)
+        {
+            __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+            uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, needle)));
+            if (mask) return i + CountTrailingZeros(mask);
+        }
+        return i + FindCharScalar(data + i, size - i, c);
+    }
+
+    NXML_TARGET_SSE2 static size_t FindNameEndSSE2(const char* data, size_t size)
+    {
+        const __m128i slash = _mm_set1_epi8('/');
+        const __m128i close = _mm_set1_epi8('>');
+        const __m128i space = _mm_set1_epi8(' ');
+        size_t i = 0;
+        for (; i + 16 <= size; i += 16)
+        {
+            __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+            // unsigned chunk <= ' ' is the same as max(chunk, ' ') == ' '
+            __m128i hits = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, slash), _mm_cmpeq_epi8(chunk, close)),
+                                        _mm_cmpeq_epi8(_mm_max_epu8(chunk, space), space));
+            uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(hits));
+            if (mask) return i + CountTrailingZeros(mask);
+        }
+        return i + FindNameEndScalar(data + i, size - i);
+    }
+
+    NXML_TARGET_SSE2 static size_t FindEscapeSSE2(const char* data, size_t size)
+    {
+        const __m128i amp = _mm_set1_epi8('&');
+        const __m128i lt = _mm_set1_epi8('<');
+        const __m128i gt = _mm_set1_epi8('>');
+        const __m128i quote = _mm_set1_epi8('"');
+        size_t i = 0;
+        for (; i + 16 <= size; i += 16)
+        {
+            __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+            __m128i hits = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, amp), _mm_cmpeq_epi8(chunk, lt)),
+                                        _mm_or_si128(_mm_cmpeq_epi8(chunk, gt), _mm_cmpeq_epi8(chunk, quote)));
+            uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(hits));
+            if (mask) return i + CountTrailingZeros(mask);
+        }
+        return i + FindEscapeScalar(data + i, size - i);
+    }
+
+    NXML_TARGET_AVX2 static size_t FindCharAVX2(const char* data, size_t size, char c)
+    {
+        const __m256i needle = _mm256_set1_epi8(c);
+        size_t i = 0;
+        for (; i + 64 <= size; i += 64)
+        {
+            __m256i a = _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i)), needle);
+            __m256i b = _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i + 32)), needle);
+            if (_mm256_testz_si256(_mm256_or_si256(a, b), _mm256_or_si256(a, b))) continue;
+
+            uint64_t mask = static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(a)))
+                          | static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(b))) << 32;
+            return i + CountTrailingZeros64(mask);
+        }
+        for (; i + 32 <= size; i += 32)
+        {
+            __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+            uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, needle)));
+            if (mask) return i + CountTrailingZeros(mask);
+        }
+        return i + FindCharSSE2(data + i, size - i, c);
+    }
+
+    NXML_TARGET_AVX2 static size_t FindNameEndAVX2(const char* data, size_t size)
+    {
+        const __m256i slash = _mm256_set1_epi8('/');
+        const __m256i close = _mm256_set1_epi8('>');
+        const __m256i space = _mm256_set1_epi8(' ');
+        size_t i = 0;
+        for (; i + 32 <= size; i += 32)
+        {
+            __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+            __m256i hits = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(chunk, slash), _mm256_cmpeq_epi8(chunk, close)),
+                                           _mm256_cmpeq_epi8(_mm256_max_epu8(chunk, space), space));
+            uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(hits));
+            if (mask) return i + CountTrailingZeros(mask);
+        }
+        return i + FindNameEndSSE2(data + i, size - i);
+    }
+
+    NXML_TARGET_AVX2 static size_t FindEscapeAVX2(const char* data, size_t size)
+    {
+        const __m256i amp = _mm256_set1_epi8('&');
+        const __m256i lt = _mm256_set1_epi8('<');
+        const __m256i gt = _mm256_set1_epi8('>');
+        const __m256i quote = _mm256_set1_epi8('"');
+        size_t i = 0;
+        for (; i + 32 <= size; i += 32)
+        {
+            __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+            __m256i hits = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(chunk, amp), _mm256_cmpeq_epi8(chunk, lt)),
+                                           _mm256_or_si256(_mm256_cmpeq_epi8(chunk, gt), _mm256_cmpeq_epi8(chunk, quote)));
+            uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(hits));
+            if (mask) return i + CountTrailingZeros(mask);
+        }
+        return i + FindEscapeSSE2(data + i, size - i);
+    }
+#endif
+
+    struct Kernels
+    {
+        Level   ActiveLevel;
+        size_t  (*FindChar)(const char*, size_t, char);
+        size_t  (*FindNameEnd)(const char*, size_t);
+        size_t  (*FindEscape)(const char*, size_t);
+    };
+
+    static const Kernels* SelectKernels(Level level)
+    {
+        // one constant table per level, switching level swaps a pointer rather than rewriting a table parsers are reading
+        static const Kernels scalar{ Level::Scalar, &FindCharScalar, &FindNameEndScalar, &FindEscapeScalar };
+#ifdef NXML_SIMD_X86
+        static const Kernels sse2{ Level::SSE2, &FindCharSSE2, &FindNameEndSSE2, &FindEscapeSSE2 };
+        static const Kernels avx2{ Level::AVX2, &FindCharAVX2, &FindNameEndAVX2, &FindEscapeAVX2 };
+        if (level == Level::AVX2) return &avx2;
+        if (level == Level::SSE2) return &sse2;
+#endif
+        return &scalar;
+    }
+
+    static std::atomic<const Kernels*>& ActiveKernelSlot()
+    {
+        static std::atomic<const Kernels*> active(SelectKernels(DetectLevel()));
+        return active;
+    }
+
+    static const Kernels& ActiveKernels()
+    {
+        return *ActiveKernelSlot().load(std::memory_order_acquire);
+    }
+}
+
+nxml::simd::Level nxml::simd::DetectLevel()
+{
+#if defined(NXML_SIMD_X86) && defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    int maxLeaf = info[0];
+    __cpuid(info, 1);
+    bool osSavesYmm = (info[2] & (1 << 27)) && (_xgetbv(0) & 0x6) == 0x6;
+    if (maxLeaf >= 7 && osSavesYmm)
+    {
+        __cpuidex(info, 7, 0);
+        if (info[1] & (1 << 5)) return Level::AVX2;
+    }
+    return (info[3] & (1 << 26)) ? Level::SSE2 : Level::Scalar;
+#elif defined(NXML_SIMD_X86)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return Level::AVX2;
+    if (__builtin_cpu_supports("sse2")) return Level::SSE2;
+    return Level::Scalar;
+#else
+    return Level::Scalar;
+#endif
+}
+
+nxml::simd::Level nxml::simd::GetLevel()
+{
+    return ActiveKernels().ActiveLevel;
+}
+
+void nxml::simd::SetLevel(Level level)
+{
+    // never go wider than the CPU actually supports
+    Level supported = DetectLevel();
+    // parsers already running finish their current scan with the old kernels, which stay valid
+    ActiveKernelSlot().store(SelectKernels(static_cast<int>(level) > static_cast<int>(supported) ? supported : level), std::memory_order_release);
+}
+
+size_t nxml::simd::FindChar(const char* data, size_t size, char c)
+{
+    return ActiveKernels().FindChar(data, size, c);
+}
+
+size_t nxml::simd::FindNameEnd(const char* data, size_t size)
+{
+    return ActiveKernels().FindNameEnd(data, size);
+}
+
+size_t nxml::simd::FindEscape(const char* data, size_t size)
+{
+    return ActiveKernels().FindEscape(data, size);
+}
+
+namespace nxml
+{
+    static bool DecodeReference(string_view name, string& out)
+    {
+        if (name == "amp") { out.push_back('&'); return true; }
+        if (name == "lt") { out.push_back('<'); return true; }
+        if (name == "gt") { out.push_back('>'); return true; }
+        if (name == "quot") { out.push_back('"'); return true; }
+        if (name == "apos") { out.push_back('\''); return true; }
+        if (name.size() < 2 || name[0] != '#') return false;
+
+        // XML only allows a lowercase x, &#X41; is not a character reference
+        bool hex = name[1] == 'x';
+        string_view digits = name.substr(hex ? 2 : 1);
+        uint32_t code = 0;
+        auto result = std::from_chars(digits.data(), digits.data() + digits.size(), code, hex ? 16 : 10);
+        if (digits.empty() || result.ec != std::errc() || result.ptr != digits.data() + digits.size()) return false;
+        if (code == 0 || code > 0x10FFFF || (code >= 0xD800 && code <= 0xDFFF)) return false;
+
+        // UTF-8
+        if (code < 0x80)
+        {
+            out.push_back(static_cast<char>(code));
+        }
+        else if (code < 0x800)
+        {
+            out.push_back(static_cast<char>(0xC0 | (code >> 6)));
+            out.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+        }
+        else if (code < 0x10000)
+        {
+            out.push_back(static_cast<char>(0xE0 | (code >> 12)));
+            out.push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3F)));
+            out.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+        }
+        else
+        {
+            out.push_back(static_cast<char>(0xF0 | (code >> 18)));
+            out.push_back(static_cast<char>(0x80 | ((code >> 12) & 0x3F)));
+            out.push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3F)));
+            out.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+        }
+        return true;
+    }
+
+    static const char* EscapeFor(char c)
+    {
+        switch (c)
+        {
+            case '&': return "&amp;";
+            case '<': return "&lt;";
+            case '>': return "&gt;";
+            case '"': return "&quot;";
+            default: return nullptr;
+        }
+    }
+}
+
+void nxml::DecodeEntities(std::string_view text, std::string& out)
+{
+    // never longer than the input, so out grows at most once
+    out.reserve(out.size() + text.size());
+
+    size_t i = 0;
+    while (i < text.size())
+    {
+        size_t amp = i + simd::FindChar(text.data() + i, text.size() - i, '&');
+        out.append(text.data() + i, amp - i);
+        if (amp == text.size()) break;
+
+        // references are short, a ';' further away than any valid one means a stray '&'
+        size_t semicolon = text.find(';', amp + 1);
+        if (semicolon == std::string_view::npos || semicolon - amp > 12 || !DecodeReference(text.substr(amp + 1, semicolon - amp - 1), out))
+        {
+            out.push_back('&');
+            i = amp + 1;
+            continue;
+        }
+        i = semicolon + 1;
+    }
+}
+
+void nxml::EscapeText(std::string_view text, std::string& out)
+{
+    size_t i = 0;
+    while (i < text.size())
+    {
+        size_t special = i + simd::FindEscape(text.data() + i, text.size() - i);
+        out.append(text.data() + i, special - i);
+        if (special == text.size()) break;
+
+        out.append(EscapeFor(text[special]));
+        i = special + 1;
+    }
+}
+
+nxml::Parser::Parser()
+{
+    p_Mode = Parser::Mode::Declaration;
+    p_Handler = nullptr;
+    p_Position = 0;
+    p_AttributeQuote = '\0';
+    p_PreviousChar = '\0';
+    p_TraceListener = nullptr;
+    p_Projection = nullptr;
+    p_ProjectedNode = nullptr;
+    p_SkipState = SkipState::Content;
+    p_SkipTag = SkipTag::Open;
+    p_SkipDepth = 0;
+    p_SkipPrevious = '\0';
+    p_SkipQuote = '\0';
+}
+
+nxml::Element::Element(Element::Type type) : ElementType(type)
+{
+
+}
+
+nxml::Element nxml::Element::Invalid = nxml::Element(Element::Type::Invalid);
+
+namespace nxml
+{
+    static bool DecodeInt(string_view text, int64_t& out)
+    {
+        text = StripPlusSign(TrimValue(text), false);
+        auto result = std::from_chars(text.data(), text.data() + text.size(), out);
+        return result.ec == std::errc() && result.ptr == text.data() + text.size() && !text.empty();
+    }
+
+    static bool DecodeDouble(string_view text, double& out)
+    {
+        text = StripPlusSign(TrimValue(text), true);
+        auto result = std::from_chars(text.data(), text.data() + text.size(), out);
+        return result.ec == std::errc() && result.ptr == text.data() + text.size() && !text.empty();
+    }
+
+    static bool DecodeBool(string_view text, bool& out)
+    {
+        text = TrimValue(text);
+        if (text == "true" || text == "1") out = true;
+        else if (text == "false" || text == "0") out = false;
+        else return false;
+        return true;
+    }
+}
+
+bool nxml::Date::Parse(std::string_view text, Date& out)
+{
+    text = TrimValue(text);
+    // count 0 reads a year: at least 4 digits, at most 9 so the value stays within int
+    auto digits = [&](size_t& i, size_t count, int& value)
+    {
+        size_t start = i;
+        size_t limit = count == 0 ? 9 : count;
+        value = 0;
+        while (i < text.size() && isdigit(static_cast<unsigned char>(text[i])) && i - start < limit)
+        {
+            value = value * 10 + (text[i++] - '0');
+        }
+        return count == 0 ? i - start >= 4 : i - start == count;
+    };
+
+    Date date;
+    size_t i = 0;
+    bool negative = i < text.size() && text[i] == '-';
+    if (negative) i++;
+
+    if (!digits(i, 0, date.Year) || i >= text.size() || text[i++] != '-') return false;
+    if (!digits(i, 2, date.Month) || i >= text.size() || text[i++] != '-') return false;
+    if (!digits(i, 2, date.Day)) return false;
+    if (negative) date.Year = -date.Year;
+    if (date.Month < 1 || date.Month > 12 || date.Day < 1) return false;
+    static const int daysInMonth[] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+    bool leap = date.Year % 4 == 0 && (date.Year % 100 != 0 || date.Year % 400 == 0);
+    if (date.Day > daysInMonth[date.Month - 1] + (date.Month == 2 && leap ? 1 : 0)) return false;
+
+    if (i < text.size())
+    {
+        date.HasZone = true;
+        if (text[i] == 'Z')
+        {
+            if (++i != text.size()) return false;
+        }
+        else
+        {
+            if (text[i] != '+' && text[i] != '-') return false;
+            int sign = text[i++] == '-' ? -1 : 1;
+            int hours, minutes;
+            if (!digits(i, 2, hours) || i >= text.size() || text[i++] != ':' || !digits(i, 2, minutes) || i != text.size()) return false;
+            // xs:date zones run from -14:00 to +14:00
+            if (minutes >= 60 || hours * 60 + minutes > 14 * 60) return false;
+            date.ZoneOffsetMinutes = sign * (hours * 60 + minutes);
+        }
+    }
+
+    out = date;
+    return true;
+}
+
+std::string nxml::Date::ToString() const
+{
+    char buffer[32];
+    int length = std::snprintf(buffer, sizeof(buffer), "%s%04d-%02d-%02d", Year < 0 ? "-" : "", Year < 0 ? -Year : Year, Month, Day);
+    std::string out(buffer, static_cast<size_t>(length));
+
+    if (HasZone)
+    {
+        if (ZoneOffsetMinutes == 0)
+        {
+            out += 'Z';
+        }
+        else
+        {
+            int offset = ZoneOffsetMinutes < 0 ? -ZoneOffsetMinutes : ZoneOffsetMinutes;
+            length = std::snprintf(buffer, sizeof(buffer), "%c%02d:%02d", ZoneOffsetMinutes < 0 ? '-' : '+', offset / 60, offset % 60);
+            out.append(buffer, static_cast<size_t>(length));
+        }
+    }
+    return out;
+}
+
+std::string_view nxml::TrimValue(std::string_view text)
+{
+    while (!text.empty() && isspace(static_cast<unsigned char>(text.front()))) text.remove_prefix(1);
+    while (!text.empty() && isspace(static_cast<unsigned char>(text.back()))) text.remove_suffix(1);
+    return text;
+}
+
+std::string_view nxml::StripPlusSign(std::string_view text, bool fraction)
+{
+    if (text.size() > 1 && text[0] == '+' && (isdigit(static_cast<unsigned char>(text[1])) || (fraction && text[1] == '.')))
+    {
+        text.remove_prefix(1);
+    }
+    return text;
+}
+
+bool nxml::ReadValue(std::string_view text, bool& out)
+{
+    return DecodeBool(text, out);
+}
+
+bool nxml::ReadValue(std::string_view text, Date& out)
+{
+    return Date::Parse(text, out);
+}
+
+void nxml::WriteValue(std::string& out, const Date& value)
+{
+    out = value.ToString();
+}
+
+int64_t nxml::Attribute::AsInt(int64_t fallback) const
+{
+    int64_t value;
+    return DecodeInt(SerializedValue, value) ? value : fallback;
+}
+
+double nxml::Attribute::AsDouble(double fallback) const
+{
+    double value;
+    return DecodeDouble(SerializedValue, value) ? value : fallback;
+}
+
+bool nxml::Attribute::AsBool(bool fallback) const
+{
+    bool value;
+    return DecodeBool(SerializedValue, value) ? value : fallback;
+}
+
+nxml::Date nxml::Attribute::AsDate() const
+{
+    Date value;
+    Date::Parse(SerializedValue, value);
+    return value;
+}
+
+int64_t nxml::Element::AsInt(int64_t fallback) const
+{
+    int64_t value;
+    return DecodeInt(InnerValue, value) ? value : fallback;
+}
+
+double nxml::Element::AsDouble(double fallback) const
+{
+    double value;
+    return DecodeDouble(InnerValue, value) ? value : fallback;
+}
+
+bool nxml::Element::AsBool(bool fallback) const
+{
+    bool value;
+    return DecodeBool(InnerValue, value) ? value : fallback;
+}
+
+nxml::Date nxml::Element::AsDate() const
+{
+    Date value;
+    Date::Parse(InnerValue, value);
+    return value;
+}
+
+int64_t nxml::AttributeView::AsInt(int64_t fallback) const
+{
+    int64_t value;
+    return DecodeInt(SerializedValue, value) ? value : fallback;
+}
+
+double nxml::AttributeView::AsDouble(double fallback) const
+{
+    double value;
+    return DecodeDouble(SerializedValue, value) ? value : fallback;
+}
+
+bool nxml::AttributeView::AsBool(bool fallback) const
+{
+    bool value;
+    return DecodeBool(SerializedValue, value) ? value : fallback;
+}
+
+nxml::Date nxml::AttributeView::AsDate() const
+{
+    Date value;
+    Date::Parse(SerializedValue, value);
+    return value;
+}
+
+nxml::Element&  nxml::Element::operator[](const char* key)
+{
+    for (Element& e : InnerElements)
+    {
+        if (e.ElementName == key) return e;
+    }
+    return Element::Invalid;
+}
+
+nxml::Element& nxml::Element::operator[](const ElementWithAttribute& search)
+{
+    for (Element& e : InnerElements)
+    {
+        if (e.ElementName == search.ElementName)
+        {
+            for (Attribute& attr : e.Attributes)
             {
                 if (attr.Key == search.AttributeName && attr.SerializedValue == search.AttributeValue)
                 {
-                    return e;
+                    return e;
+                }
+            }
+        }
+    }
+    return Element::Invalid;
+}
+
+std::string nxml::Element::ToString()
+{
+    std::string out;
+    StringSink sink(out);
+    Serializer serializer(sink, Serializer::WhiteSpace::Preserve);
+    serializer.Write(*this);
+    serializer.Flush();
+    return out;
+}
+
+nxml::Element& nxml::Document::operator[](const char* key)
+{
+    for (Element& e : RootElements)
+    {
+        if (e.ElementName == key) return e;
+    }
+    return Element::Invalid;
+}
+
+std::string nxml::Document::ToString()
+{
+    std::string out;
+    StringSink sink(out);
+    Serializer serializer(sink, Serializer::WhiteSpace::Collapse);
+    serializer.Write(*this);
+    serializer.Flush();
+    return out;
+}
+
+nxml::Atom nxml::NameTable::Intern(std::string_view name)
+{
+    {
+        std::shared_lock<std::shared_mutex> lock(p_Mutex);
+        auto it = p_Lookup.find(name);
+        if (it != p_Lookup.end()) return it->second;
+    }
+
+    std::unique_lock<std::shared_mutex> lock(p_Mutex);
+    // another thread may have interned it between the two locks
+    auto it = p_Lookup.find(name);
+    if (it != p_Lookup.end()) return it->second;
+
+    NXML_ASSERT(p_Count < None - FirstChunkSize, "Name table is full");
+
+    Atom atom = p_Count++;
+    uint32_t slot = atom + FirstChunkSize;
+    uint32_t index = HighestBit(slot) - FirstChunkBits;
+    unique_ptr<string[]>& chunk = p_Chunks[index];
+    if (!chunk) chunk = std::make_unique<string[]>(FirstChunkSize << index);
+
+    string& stored = chunk[slot - (FirstChunkSize << index)];
+    stored = string(name);
+    p_Lookup.emplace(string_view(stored), atom);
+    return atom;
+}
+
+nxml::Atom nxml::NameTable::Find(std::string_view name) const
+{
+    std::shared_lock<std::shared_mutex> lock(p_Mutex);
+    auto it = p_Lookup.find(name);
+    return it == p_Lookup.end() ? None : it->second;
+}
+
+size_t nxml::NameTable::Size() const
+{
+    std::shared_lock<std::shared_mutex> lock(p_Mutex);
+    return p_Count;
+}
+
+nxml::NodeArena::NodeArena(std::shared_ptr<NameTable> names) : Arena(&Upstream), Names(names ? std::move(names) : std::make_shared<NameTable>()), Nodes(&Arena), Attributes(&Arena), Dirty(&Arena), ValueCache(&Arena)
+{
+
+}
+
+void nxml::NodeArena::MarkDirty(uint32_t node)
+{
+    if (Dirty.size() < Nodes.size()) Dirty.resize(Nodes.size());
+
+    // ancestors of a dirty node are already dirty, so the walk stops at the first one found
+    while (node != None && Dirty[node] == 0)
+    {
+        Dirty[node] = 1;
+        node = Nodes[node].Parent;
+    }
+}
+
+nxml::NodeArena::CachedValue* nxml::NodeArena::CacheFor(uint32_t node)
+{
+    if (!CacheValues) return nullptr;
+    if (ValueCache.size() < Nodes.size()) ValueCache.resize(Nodes.size());
+    return &ValueCache[node];
+}
+
+nxml::Atom nxml::NodeArena::Intern(std::string_view name)
+{
+    auto it = NameCache.find(name);
+    if (it != NameCache.end()) return it->second;
+
+    Atom atom = Names->Intern(name);
+    NameCache.emplace(Names->Name(atom), atom);
+    return atom;
+}
+
+nxml::Atom nxml::NodeArena::Find(std::string_view name) const
+{
+    auto it = NameCache.find(name);
+    if (it != NameCache.end()) return it->second;
+    return Names->Find(name);
+}
+
+uint32_t nxml::NodeArena::AppendNode(uint32_t parent, Element::Type elementType, std::string_view name)
+{
+    uint32_t index = static_cast<uint32_t>(Nodes.size());
+
+    Node& node = Nodes.emplace_back();
+    node.ElementType = elementType;
+    node.Name = Intern(name);
+    node.Parent = parent;
+
+    uint32_t& first = parent == None ? FirstRoot : Nodes[parent].FirstChild;
+    uint32_t& last  = parent == None ? LastRoot : Nodes[parent].LastChild;
+
+    if (last != None) Nodes[last].NextSibling = index;
+    else first = index;
+    last = index;
+
+    return index;
+}
+
+uint32_t nxml::NodeArena::AppendAttribute(uint32_t node, std::string_view key, std::string_view value)
+{
+    uint32_t index = static_cast<uint32_t>(Attributes.size());
+
+    AttributeNode& attr = Attributes.emplace_back();
+    attr.Key = Intern(key);
+    attr.SerializedValue = value;
+
+    Node& owner = Nodes[node];
+    if (owner.LastAttribute != None) Attributes[owner.LastAttribute].Next = index;
+    else owner.FirstAttribute = index;
+    owner.LastAttribute = index;
+
+    return index;
+}
+
+std::string_view nxml::NodeArena::Copy(std::string_view value)
+{
+    if (value.empty()) return std::string_view();
+
+    char* data = static_cast<char*>(Arena.allocate(value.size(), 1));
+    std::memcpy(data, value.data(), value.size());
+    return std::string_view(data, value.size());
+}
+
+const nxml::ElementView nxml::ElementView::Invalid = nxml::ElementView();
+
+nxml::Element::Type nxml::ElementView::ElementType() const
+{
+    return IsValid() ? p_Nodes->Nodes[p_Index].ElementType : Element::Type::Invalid;
+}
+
+std::string_view nxml::ElementView::ElementName() const
+{
+    return IsValid() ? p_Nodes->Names->Name(p_Nodes->Nodes[p_Index].Name) : std::string_view();
+}
+
+nxml::Atom nxml::ElementView::NameAtom() const
+{
+    return IsValid() ? p_Nodes->Nodes[p_Index].Name : NameTable::None;
+}
+
+std::string_view nxml::ElementView::InnerValue() const
+{
+    return IsValid() ? p_Nodes->Nodes[p_Index].InnerValue : std::string_view();
+}
+
+nxml::ElementRange nxml::ElementView::InnerElements() const
+{
+    return ElementRange(p_Nodes, IsValid() ? p_Nodes->Nodes[p_Index].FirstChild : NodeArena::None);
+}
+
+nxml::AttributeRange nxml::ElementView::Attributes() const
+{
+    return AttributeRange(p_Nodes, IsValid() ? p_Nodes->Nodes[p_Index].FirstAttribute : NodeArena::None);
+}
+
+nxml::ElementView nxml::ElementView::Parent() const
+{
+    return IsValid() ? ElementView(p_Nodes, p_Nodes->Nodes[p_Index].Parent) : ElementView::Invalid;
+}
+
+nxml::ElementView nxml::ElementView::operator[](const char* key) const
+{
+    if (!IsValid()) return ElementView::Invalid;
+
+    // a name the table has never seen cannot be in the document
+    Atom atom = p_Nodes->Find(key);
+    if (atom == NameTable::None) return ElementView::Invalid;
+
+    for (uint32_t i = p_Nodes->Nodes[p_Index].FirstChild; i != NodeArena::None; i = p_Nodes->Nodes[i].NextSibling)
+    {
+        if (p_Nodes->Nodes[i].Name == atom) return ElementView(p_Nodes, i);
+    }
+    return ElementView::Invalid;
+}
+
+nxml::ElementView nxml::ElementView::operator[](const ElementWithAttribute& search) const
+{
+    if (!IsValid()) return ElementView::Invalid;
+
+    Atom name = p_Nodes->Find(search.ElementName);
+    Atom key = p_Nodes->Find(search.AttributeName);
+    if (name == NameTable::None || key == NameTable::None) return ElementView::Invalid;
+
+    for (uint32_t i = p_Nodes->Nodes[p_Index].FirstChild; i != NodeArena::None; i = p_Nodes->Nodes[i].NextSibling)
+    {
+        if (p_Nodes->Nodes[i].Name != name) continue;
+
+        for (uint32_t a = p_Nodes->Nodes[i].FirstAttribute; a != NodeArena::None; a = p_Nodes->Attributes[a].Next)
+        {
+            const NodeArena::AttributeNode& attr = p_Nodes->Attributes[a];
+            if (attr.Key == key && attr.SerializedValue == search.AttributeValue)
+            {
+                return ElementView(p_Nodes, i);
+            }
+        }
+    }
+    return ElementView::Invalid;
+}
+
+void nxml::ElementView::SetInnerValue(std::string_view value)
+{
+    NXML_ASSERT(IsValid(), "Cannot assign a value to an invalid element");
+    p_Nodes->Nodes[p_Index].InnerValue = p_Nodes->Copy(value);
+    p_Nodes->MarkDirty(p_Index);
+
+    if (NodeArena::CachedValue* cached = p_Nodes->CacheFor(p_Index)) cached->State = NodeArena::CacheState::Empty;
+}
+
+int64_t nxml::ElementView::AsInt(int64_t fallback) const
+{
+    if (!IsValid()) return fallback;
+
+    NodeArena::CachedValue* cached = p_Nodes->CacheFor(p_Index);
+    if (cached != nullptr)
+    {
+        if (cached->State == NodeArena::CacheState::Int) return cached->Int;
+        if (cached->State == NodeArena::CacheState::NotInt) return fallback;
+    }
+
+    int64_t value = 0;
+    bool decoded = DecodeInt(InnerValue(), value);
+    if (cached != nullptr)
+    {
+        cached->State = decoded ? NodeArena::CacheState::Int : NodeArena::CacheState::NotInt;
+        cached->Int = value;
+    }
+    return decoded ? value : fallback;
+}
+
+double nxml::ElementView::AsDouble(double fallback) const
+{
+    if (!IsValid()) return fallback;
+
+    NodeArena::CachedValue* cached = p_Nodes->CacheFor(p_Index);
+    if (cached != nullptr)
+    {
+        if (cached->State == NodeArena::CacheState::Double) return cached->Double;
+        if (cached->State == NodeArena::CacheState::NotDouble) return fallback;
+    }
+
+    double value = 0.0;
+    bool decoded = DecodeDouble(InnerValue(), value);
+    if (cached != nullptr)
+    {
+        cached->State = decoded ? NodeArena::CacheState::Double : NodeArena::CacheState::NotDouble;
+        cached->Double = value;
+    }
+    return decoded ? value : fallback;
+}
+
+bool nxml::ElementView::AsBool(bool fallback) const
+{
+    bool value;
+    return IsValid() && DecodeBool(InnerValue(), value) ? value : fallback;
+}
+
+nxml::Date nxml::ElementView::AsDate() const
+{
+    Date value;
+    Date::Parse(InnerValue(), value);
+    return value;
+}
+
+void nxml::ElementView::SetInt(int64_t value)
+{
+    char buffer[32];
+    auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+    SetInnerValue(std::string_view(buffer, static_cast<size_t>(result.ptr - buffer)));
+
+    if (NodeArena::CachedValue* cached = p_Nodes->CacheFor(p_Index))
+    {
+        cached->State = NodeArena::CacheState::Int;
+        cached->Int = value;
+    }
+}
+
+void nxml::ElementView::SetDouble(double value)
+{
+    char buffer[64];
+    auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+    SetInnerValue(std::string_view(buffer, static_cast<size_t>(result.ptr - buffer)));
+
+    if (NodeArena::CachedValue* cached = p_Nodes->CacheFor(p_Index))
+    {
+        cached->State = NodeArena::CacheState::Double;
+        cached->Double = value;
+    }
+}
+
+void nxml::ElementView::SetDate(const Date& value)
+{
+    SetInnerValue(value.ToString());
+}
+
+void nxml::ElementView::SetAttribute(std::string_view key, std::string_view value)
+{
+    NXML_ASSERT(IsValid(), "Cannot assign an attribute to an invalid element");
+    p_Nodes->MarkDirty(p_Index);
+
+    Atom atom = p_Nodes->Intern(key);
+    uint32_t index = p_Nodes->Nodes[p_Index].FirstAttribute;
+    while (index != NodeArena::None)
+    {
+        NodeArena::AttributeNode& attr = p_Nodes->Attributes[index];
+        if (attr.Key == atom)
+        {
+            attr.SerializedValue = p_Nodes->Copy(value);
+            return;
+        }
+        index = attr.Next;
+    }
+
+    p_Nodes->AppendAttribute(p_Index, key, p_Nodes->Copy(value));
+}
+
+std::string_view nxml::ElementView::SourceText() const
+{
+    if (!IsValid()) return std::string_view();
+
+    const NodeArena::Node& node = p_Nodes->Nodes[p_Index];
+    if (node.SourceBegin == NodeArena::None || node.SourceEnd == NodeArena::None) return std::string_view();
+    return p_Nodes->Source.substr(node.SourceBegin, node.SourceEnd - node.SourceBegin);
+}
+
+nxml::Element nxml::ElementView::ToElement() const
+{
+    Element e(ElementType());
+    e.ElementName = string(ElementName());
+    e.InnerValue = string(InnerValue());
+
+    for (AttributeView attr : Attributes())
+    {
+        Attribute a;
+        a.Key = string(attr.Key);
+        a.SerializedValue = string(attr.SerializedValue);
+        e.Attributes.push_back(a);
+    }
+
+    for (ElementView inner : InnerElements())
+    {
+        e.InnerElements.emplace_back(inner.ToElement());
+    }
+    return e;
+}
+
+size_t nxml::ElementRange::size() const
+{
+    size_t count = 0;
+    for (auto it = begin(); it != end(); ++it) count++;
+    return count;
+}
+
+nxml::DocumentView::DocumentView(std::shared_ptr<NameTable> names) : p_Nodes(std::make_unique<NodeArena>(std::move(names)))
+{
+
+}
+
+nxml::ElementView nxml::DocumentView::operator[](const char* key) const
+{
+    Atom atom = p_Nodes->Find(key);
+    if (atom == NameTable::None) return ElementView::Invalid;
+
+    for (uint32_t i = p_Nodes->FirstRoot; i != NodeArena::None; i = p_Nodes->Nodes[i].NextSibling)
+    {
+        if (p_Nodes->Nodes[i].Name == atom) return ElementView(p_Nodes.get(), i);
+    }
+    return ElementView::Invalid;
+}
+
+nxml::ElementRange nxml::DocumentView::RootElements() const
+{
+    return ElementRange(p_Nodes.get(), p_Nodes->FirstRoot);
+}
+
+size_t nxml::DocumentView::NodeCount() const
+{
+    return p_Nodes->Nodes.size();
+}
+
+std::shared_ptr<nxml::NameTable> nxml::DocumentView::Names() const
+{
+    return p_Nodes->Names;
+}
+
+void nxml::DocumentView::SetValueCaching(bool enabled)
+{
+    p_Nodes->CacheValues = enabled;
+    if (!enabled)
+    {
+        p_Nodes->ValueCache.clear();
+    }
+}
+
+nxml::Document nxml::DocumentView::ToDocument() const
+{
+    Document doc;
+    for (ElementView e : RootElements())
+    {
+        doc.RootElements.emplace_back(e.ToElement());
+    }
+    return doc;
+}
+
+std::string nxml::DocumentView::ToString()
+{
+    std::string out;
+    out.reserve(Source.size());
+    StringSink sink(out);
+    Serializer serializer(sink, Serializer::WhiteSpace::Collapse);
+    serializer.Write(*this);
+    serializer.Flush();
+    return out;
+}
+
+std::string nxml::DocumentView::ToSourceString()
+{
+    std::string out;
+    out.reserve(Source.size());
+    StringSink sink(out);
+    Serializer serializer(sink, Serializer::WhiteSpace::Original);
+    serializer.Write(*this);
+    serializer.Flush();
+    return out;
+}
+
+nxml::Query::Query(std::string_view expression) : p_Expression(expression)
+{
+    Compile();
+}
+
+void nxml::Query::Compile()
+{
+    string_view text = p_Expression;
+    size_t i = 0;
+
+    auto fail = [&](const char* message)
+    {
+        p_Error = string(message) + " at offset " + std::to_string(i) + " in '" + p_Expression + "'";
+        p_Steps.clear();
+    };
+    auto isNameChar = [](char c) { return c != '/' && c != '[' && c != ']' && c != '=' && c != '@' && c != '\'' && c != '"' && !isspace(static_cast<unsigned char>(c)); };
+
+    // a leading / only anchors at the queried node, which is where evaluation starts anyway
+    if (text.substr(0, 2) != "//" && !text.empty() && text[0] == '/') i++;
+
+    while (i < text.size())
+    {
+        Step step;
+        if (text.compare(i, 2, "//") == 0)
+        {
+            step.Descendant = true;
+            i += 2;
+        }
+
+        size_t nameStart = i;
+        while (i < text.size() && isNameChar(text[i])) i++;
+        step.Name = string(text.substr(nameStart, i - nameStart));
+        if (step.Name.empty()) return fail("expected an element name");
+        if (step.Name == "*") step.Name.clear();
+
+        while (i < text.size() && text[i] == '[')
+        {
+            i++;
+            Predicate predicate;
+            if (i < text.size() && text[i] == '@')
+            {
+                size_t keyStart = ++i;
+                while (i < text.size() && isNameChar(text[i])) i++;
+                predicate.Attribute = string(text.substr(keyStart, i - keyStart));
+                if (predicate.Attribute.empty()) return fail("expected an attribute name");
+
+                if (i < text.size() && text[i] == '=')
+                {
+                    i++;
+                    if (i >= text.size() || (text[i] != '\'' && text[i] != '"')) return fail("expected a quoted value");
+                    char quote = text[i++];
+                    size_t valueEnd = text.find(quote, i);
+                    if (valueEnd == string_view::npos) return fail("unterminated value");
+                    predicate.Value = string(text.substr(i, valueEnd - i));
+                    predicate.HasValue = true;
+                    i = valueEnd + 1;
+                }
+            }
+            else
+            {
+                while (i < text.size() && isdigit(static_cast<unsigned char>(text[i])))
+                {
+                    predicate.Position = predicate.Position * 10 + static_cast<size_t>(text[i++] - '0');
+                }
+                if (predicate.Position == 0) return fail("expected @attribute or a position of 1 or more");
+            }
+
+            if (i >= text.size() || text[i] != ']') return fail("expected ]");
+            i++;
+            step.Predicates.push_back(std::move(predicate));
+        }
+
+        p_Steps.push_back(std::move(step));
+
+        if (i < text.size())
+        {
+            if (text[i] != '/') return fail("unexpected character");
+            // a double slash is consumed by the next step
+            if (text.compare(i, 2, "//") != 0) i++;
+            if (i == text.size()) return fail("expected a step after /");
+        }
+    }
+
+    if (p_Steps.empty()) fail("empty expression");
+}
+
+namespace nxml
+{
+    /// <summary>
+    /// Evaluates a compiled Query over either tree representation. Traits supply the child list
+    /// of a node (Parent), iteration over it, and name/attribute access, so both share one implementation.
+    /// </summary>
+    template <typename Traits>
+    struct QueryEvaluator
+    {
+        using Parent = typename Traits::Parent;
+        using Node = typename Traits::Node;
+        using Iterator = typename Traits::Iterator;
+        using Key = typename Traits::Key;
+
+        // a scope whose children are being visited, Counters is where its positional counts start
+        struct Frame
+        {
+            Iterator    It;
+            Iterator    End;
+            bool        Active;
+            size_t      Counters;
+        };
+
+        static bool Matches(const Query::Predicate& predicate, Key key, Node node)
+        {
+            bool found = false;
+            Traits::ForEachAttribute(node, [&](Key attribute, string_view value)
+            {
+                if (!found && attribute == key && (!predicate.HasValue || value == predicate.Value)) found = true;
+            });
+            return found;
+        }
+
+        static bool Accepts(const Query::Step& step, Key name, const vector<Key>& keys, size_t* counters, Node child)
+        {
+            if (!step.Name.empty() && !Traits::NameIs(child, name)) return false;
+
+            // predicates apply in order, so each positional predicate counts only siblings that passed the ones before it
+            for (size_t p = 0; p < step.Predicates.size(); p++)
+            {
+                const Query::Predicate& predicate = step.Predicates[p];
+                if (predicate.Position != 0)
+                {
+                    if (++counters[p] != predicate.Position) return false;
+                }
+                else if (!Matches(predicate, keys[p], child))
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        // One pre-order walk over the subtrees of parents, which are in document order, testing the children of every scope
+        // the step applies to: any scope below a parent for descendant steps, the parents themselves for child steps.
+        // A parent nested inside an earlier one's subtree is recognised when the walk reaches it, so every node is visited
+        // once and matches come out in document order.
+        static void Walk(const Query::Step& step, Key name, const vector<Key>& keys, const vector<Parent>& parents,
+                         vector<Frame>& stack, vector<size_t>& counters, vector<Node>& matches)
+        {
+            size_t next = 0;
+            while (next < parents.size())
+            {
+                Parent parent = parents[next++];
+                stack.push_back(Frame{ Traits::Begin(parent), Traits::End(parent), true, 0 });
+                counters.assign(keys.size(), 0);
+
+                while (!stack.empty())
+                {
+                    Frame& top = stack.back();
+                    if (top.It == top.End)
+                    {
+                        counters.resize(top.Counters);
+                        stack.pop_back();
+                        continue;
+                    }
+
+                    Node child = Traits::Deref(top.It);
+                    ++top.It;
+                    if (top.Active && Accepts(step, name, keys, counters.data() + top.Counters, child)) matches.push_back(child);
+
+                    Parent inner = Traits::ChildrenOf(child);
+                    if (Traits::Begin(inner) == Traits::End(inner)) continue;
+
+                    bool isParent = next < parents.size() && Traits::SameParent(inner, parents[next]);
+                    if (isParent) next++;
+
+                    bool active = step.Descendant || isParent;
+                    stack.push_back(Frame{ Traits::Begin(inner), Traits::End(inner), active, counters.size() });
+                    if (active) counters.resize(counters.size() + keys.size(), 0);
+                }
+            }
+        }
+
+        static void Evaluate(const Query& query, Parent start, vector<Node>& results)
+        {
+            if (!query.IsValid()) return;
+
+            vector<Parent> parents{ start };
+            vector<Node> matches;
+            vector<size_t> counters;
+            vector<Frame> stack;
+            vector<Key> keys;
+            // once a descendant step has run, context nodes can lie inside each other's subtrees
+            bool nested = false;
+
+            for (size_t s = 0; s < query.p_Steps.size(); s++)
+            {
+                const Query::Step& step = query.p_Steps[s];
+
+                // names are resolved once per step, for DocumentViews this turns every comparison into an atom compare
+                Key name = Traits::Resolve(start, step.Name);
+                keys.clear();
+                for (const Query::Predicate& predicate : step.Predicates) keys.push_back(Traits::Resolve(start, predicate.Attribute));
+
+                matches.clear();
+                if (step.Descendant || nested)
+                {
+                    // scopes without children add nothing, and dropping them keeps SameParent unambiguous in Walk
+                    parents.erase(std::remove_if(parents.begin(), parents.end(), [](Parent parent) { return Traits::Begin(parent) == Traits::End(parent); }), parents.end());
+                    Walk(step, name, keys, parents, stack, counters, matches);
+                    nested = true;
+                }
+                else
+                {
+                    for (Parent scope : parents)
+                    {
+                        counters.assign(keys.size(), 0);
+                        Traits::ForEach(scope, [&](Node child)
+                        {
+                            if (Accepts(step, name, keys, counters.data(), child)) matches.push_back(child);
+                        });
+                    }
+                }
+
+                if (s + 1 == query.p_Steps.size())
+                {
+                    results.insert(results.end(), matches.begin(), matches.end());
+                    return;
+                }
+
+                parents.clear();
+                for (Node node : matches) parents.push_back(Traits::ChildrenOf(node));
+                if (parents.empty()) return;
+            }
+        }
+    };
+
+    struct ElementQueryTraits
+    {
+        using Parent = vector<Element>*;
+        using Node = Element*;
+        using Key = string_view;
+        using Iterator = vector<Element>::iterator;
+
+        static Parent       ChildrenOf(Node node) { return &node->InnerElements; }
+        static Iterator     Begin(Parent parent) { return parent->begin(); }
+        static Iterator     End(Parent parent) { return parent->end(); }
+        static Node         Deref(Iterator it) { return &*it; }
+        static bool         SameParent(Parent a, Parent b) { return a == b; }
+        static Key          Resolve(Parent, const string& name) { return name; }
+        static bool         NameIs(Node node, Key name) { return node->ElementName == name; }
+
+        template <typename F>
+        static void ForEach(Parent parent, F&& f) { for (Element& e : *parent) f(&e); }
+
+        template <typename F>
+        static void ForEachAttribute(Node node, F&& f) { for (const Attribute& a : node->Attributes) f(a.Key, a.SerializedValue); }
+    };
+
+    struct ViewQueryTraits
+    {
+        using Parent = ElementRange;
+        using Node = ElementView;
+        using Key = Atom;
+        using Iterator = ElementRange::Iterator;
+
+        static Parent       ChildrenOf(Node node) { return node.InnerElements(); }
+        static Iterator     Begin(Parent parent) { return parent.begin(); }
+        static Iterator     End(Parent parent) { return parent.end(); }
+        static Node         Deref(Iterator it) { return *it; }
+        // a range is known by its first child, so this only tells non-empty ranges apart
+        static bool         SameParent(Parent a, Parent b) { return a.Arena() == b.Arena() && a.begin() == b.begin(); }
+        static Key          Resolve(Parent parent, const string& name) { return parent.Arena()->Find(name); }
+        static bool         NameIs(Node node, Key name) { return node.NameAtom() == name; }
+
+        template <typename F>
+        static void ForEach(Parent parent, F&& f) { for (ElementView e : parent) f(e); }
+
+        template <typename F>
+        static void ForEachAttribute(Node node, F&& f)
+        {
+            AttributeRange attributes = node.Attributes();
+            for (auto it = attributes.begin(); it != attributes.end(); ++it)
+            {
+                const NodeArena::AttributeNode& a = it.Nodes->Attributes[it.Index];
+                f(a.Key, a.SerializedValue);
+            }
+        }
+    };
+}
+
+std::vector<nxml::Element*> nxml::Query::Select(Document& doc) const
+{
+    vector<Element*> results;
+    Select(doc, results);
+    return results;
+}
+
+std::vector<nxml::Element*> nxml::Query::Select(Element& element) const
+{
+    vector<Element*> results;
+    Select(element, results);
+    return results;
+}
+
+void nxml::Query::Select(Document& doc, std::vector<Element*>& results) const
+{
+    QueryEvaluator<ElementQueryTraits>::Evaluate(*this, &doc.RootElements, results);
+}
+
+void nxml::Query::Select(Element& element, std::vector<Element*>& results) const
+{
+    QueryEvaluator<ElementQueryTraits>::Evaluate(*this, &element.InnerElements, results);
+}
+
+std::vector<nxml::ElementView> nxml::Query::Select(const DocumentView& doc) const
+{
+    vector<ElementView> results;
+    Select(doc, results);
+    return results;
+}
+
+std::vector<nxml::ElementView> nxml::Query::Select(ElementView element) const
+{
+    vector<ElementView> results;
+    Select(element, results);
+    return results;
+}
+
+void nxml::Query::Select(const DocumentView& doc, std::vector<ElementView>& results) const
+{
+    QueryEvaluator<ViewQueryTraits>::Evaluate(*this, doc.RootElements(), results);
+}
+
+void nxml::Query::Select(ElementView element, std::vector<ElementView>& results) const
+{
+    if (!element.IsValid()) return;
+    QueryEvaluator<ViewQueryTraits>::Evaluate(*this, element.InnerElements(), results);
+}
+
+nxml::Element& nxml::Query::SelectFirst(Document& doc) const
+{
+    vector<Element*> results;
+    Select(doc, results);
+    return results.empty() ? Element::Invalid : *results.front();
+}
+
+nxml::ElementView nxml::Query::SelectFirst(const DocumentView& doc) const
+{
+    vector<ElementView> results;
+    Select(doc, results);
+    return results.empty() ? ElementView::Invalid : results.front();
+}
+
+nxml::Projection::Projection(std::initializer_list<std::string_view> paths)
+{
+    for (std::string_view path : paths)
+    {
+        if (!Add(path)) break;
+    }
+}
+
+bool nxml::Projection::Add(std::string_view path)
+{
+    if (!path.empty() && path.front() == '/') path.remove_prefix(1);
+    if (path.empty())
+    {
+        p_Error = "empty projection path";
+        return false;
+    }
+
+    Node* node = &p_Root;
+    while (!path.empty())
+    {
+        size_t slash = path.find('/');
+        std::string_view step = path.substr(0, slash);
+        path = slash == std::string_view::npos ? std::string_view() : path.substr(slash + 1);
+
+        if (step.empty() || (step.front() == '@' && (step.size() == 1 || !path.empty())))
+        {
+            p_Error = "malformed step '" + std::string(step) + "' in projection path";
+            return false;
+        }
+
+        if (step.front() == '@')
+        {
+            step.remove_prefix(1);
+            if (step == "*") node->AllAttributes = true;
+            else node->Attributes.emplace_back(step);
+            return true;
+        }
+
+        std::string name(step == "*" ? std::string_view() : step);
+        auto found = std::find_if(node->Children.begin(), node->Children.end(), [&name](const std::unique_ptr<Node>& child) { return child->Name == name; });
+        if (found == node->Children.end())
+        {
+            node->Children.push_back(std::make_unique<Node>());
+            node->Children.back()->Name = std::move(name);
+            found = node->Children.end() - 1;
+        }
+        node = found->get();
+    }
+
+    node->Whole = true;
+    return true;
+}
+
+const nxml::Projection::Node* nxml::Projection::Node::Child(std::string_view name) const
+{
+    // a handful of children at most, an exact name wins over the wildcard
+    const Node* wildcard = nullptr;
+    for (const std::unique_ptr<Node>& child : Children)
+    {
+        if (child->Name == name) return child.get();
+        if (child->Name.empty()) wildcard = child.get();
+    }
+    return wildcard;
+}
+
+bool nxml::Projection::Node::KeepsAttribute(std::string_view key) const
+{
+    return Whole || AllAttributes || std::find(Attributes.begin(), Attributes.end(), key) != Attributes.end();
+}
+
+void nxml::Parser::Span::Append(size_t index)
+{
+    // characters are only ever appended contiguously, so a span is just a start and a length
+    if (Length == 0) Begin = index;
+    Length = index - Begin + 1;
+}
+
+std::string_view nxml::Parser::GetSpan(const Span& span) const
+{
+    return p_Source.substr(span.Begin, span.Length);
+}
+
+std::string_view nxml::Parser::GetDecodedSpan(const Span& span)
+{
+    string_view text = GetSpan(span);
+    if (simd::FindChar(text.data(), text.size(), '&') == text.size()) return text;
+
+    // callers reserve p_Decoded for the whole batch, so appending never moves earlier values
+    size_t start = p_Decoded.size();
+    DecodeEntities(text, p_Decoded);
+    return string_view(p_Decoded).substr(start);
+}
+
+void nxml::DocumentBuilder::Recycle(Document& doc)
+{
+    // an interrupted parse may have left elements behind
+    for (Frame& frame : p_ElementStack)
+    {
+        RecycleElement(frame.Node);
+    }
+    p_ElementStack.clear();
+
+    for (Element& e : doc.RootElements)
+    {
+        RecycleElement(e);
+    }
+    doc.RootElements.clear();
+}
+
+void nxml::DocumentBuilder::RecycleElement(Element& e)
+{
+    for (Element& inner : e.InnerElements)
+    {
+        RecycleElement(inner);
+    }
+    e.InnerElements.clear();
+
+    // attributes stay in place, OnAttribute overwrites them before appending new ones
+    p_Spare.emplace_back(std::move(e));
+}
+
+void nxml::DocumentBuilder::OnStartElement(std::string_view name, Element::Type elementType)
+{
+    p_ElementStack.push_back(Frame{ Element(elementType), 0 });
+    Element& e = p_ElementStack.back().Node;
+
+    if (!p_Spare.empty())
+    {
+        // ElementType is const, so a spare element donates its buffers rather than being reused whole
+        Element& spare = p_Spare.back();
+        e.ElementName.swap(spare.ElementName);
+        e.InnerValue.swap(spare.InnerValue);
+        e.Attributes.swap(spare.Attributes);
+        e.InnerElements.swap(spare.InnerElements);
+        p_Spare.pop_back();
+    }
+
+    e.ElementName.assign(name);
+    e.InnerValue.clear();
+}
+
+void nxml::DocumentBuilder::OnAttribute(std::string_view key, std::string_view value)
+{
+    Frame& frame = p_ElementStack.back();
+    vector<Attribute>& attributes = frame.Node.Attributes;
+
+    Attribute& attr = frame.AttributeCount < attributes.size() ? attributes[frame.AttributeCount] : attributes.emplace_back();
+    attr.Key.assign(key);
+    attr.SerializedValue.assign(value);
+    frame.AttributeCount++;
+}
+
+void nxml::DocumentBuilder::OnText(std::string_view value)
+{
+    p_ElementStack.back().Node.InnerValue.assign(value);
+}
+
+void nxml::DocumentBuilder::OnEndElement(std::string_view /* name */)
+{
+    Frame& frame = p_ElementStack.back();
+    frame.Node.Attributes.resize(frame.AttributeCount);
+
+    // move rather than copy, the finished subtree is handed to its parent without being duplicated
+    Element e = std::move(frame.Node);
+    p_ElementStack.pop_back();
+
+    if (p_ElementStack.empty())
+    {
+        Doc.RootElements.emplace_back(std::move(e));
+        return;
+    }
+
+    p_ElementStack.back().Node.InnerElements.emplace_back(std::move(e));
+}
+
+nxml::DocumentViewBuilder::DocumentViewBuilder(NodeArena& nodes, const Parser* parser) : p_Nodes(nodes), p_Parser(parser)
+{
+    // offsets are 32 bit like the node links, larger sources simply go without spans
+    if (p_Nodes.Source.size() >= NodeArena::None) p_Parser = nullptr;
+}
+
+void nxml::DocumentViewBuilder::OnStartElement(std::string_view name, Element::Type elementType)
+{
+    uint32_t parent = p_NodeStack.empty() ? NodeArena::None : p_NodeStack.top();
+    uint32_t index = p_Nodes.AppendNode(parent, elementType, name);
+    p_NodeStack.push(index);
+
+    const char* source = p_Nodes.Source.data();
+    if (p_Parser != nullptr && name.data() > source && name.data() <= source + p_Nodes.Source.size())
+    {
+        p_Nodes.Nodes[index].SourceBegin = static_cast<uint32_t>(name.data() - 1 - source);
+    }
+}
+
+void nxml::DocumentViewBuilder::OnAttribute(std::string_view key, std::string_view value)
+{
+    p_Nodes.AppendAttribute(p_NodeStack.top(), key, InSource(value) ? value : p_Nodes.Copy(value));
+}
+
+void nxml::DocumentViewBuilder::OnText(std::string_view value)
+{
+    p_Nodes.Nodes[p_NodeStack.top()].InnerValue = InSource(value) ? value : p_Nodes.Copy(value);
+}
+
+bool nxml::DocumentViewBuilder::InSource(std::string_view value) const
+{
+    // values with references arrive decoded in the parser's scratch buffer and have to be kept in the arena
+    const char* source = p_Nodes.Source.data();
+    return value.empty() || (value.data() >= source && value.data() + value.size() <= source + p_Nodes.Source.size());
+}
+
+void nxml::DocumentViewBuilder::OnEndElement(std::string_view /* name */)
+{
+    // nodes are linked into their parent when created, closing only has to pop the stack
+    NodeArena::Node& node = p_Nodes.Nodes[p_NodeStack.top()];
+    p_NodeStack.pop();
+
+    if (p_Parser == nullptr || node.SourceBegin == NodeArena::None) return;
+
+    // the parser closes on the character after "</" or at the '/' of "/>", the tag runs on to the next '>'.
+    // Elements left open at the end of the input close outside the source and run to its end
+    string_view source = p_Nodes.Source;
+    const char* cursor = p_Parser->Cursor();
+    size_t end = source.size();
+    if (cursor > source.data() && cursor <= source.data() + source.size())
+    {
+        size_t close = source.find('>', static_cast<size_t>(cursor - 1 - source.data()));
+        if (close != std::string_view::npos) end = close + 1;
+    }
+    node.SourceEnd = static_cast<uint32_t>(end);
+}
+
+void nxml::Parser::ClearCurrentElement()
+{        
+    // CreateElement;
+    p_ElementNameSpan.Clear();
+    p_ElementValueSpan.Clear();
+}
+
+void nxml::Parser::ClearCurrentAttribute()
+{
+    // Clear spans
+    p_AttributeNameSpan.Clear();
+    p_AttributeValueSpan.Clear();
+}
+
+void nxml::Parser::CreateElement(Element::Type elementType)
+{
+    string_view name = GetSpan(p_ElementNameSpan);
+    p_OpenElementOffsets.push_back(p_OpenElementNames.size());
+    p_OpenElementNames.append(name);
+    if (p_Projection != nullptr) p_ProjectionStack.push_back(p_ProjectedNode);
+
+    p_Handler->OnStartElement(name, elementType);
+
+    size_t valueBytes = 0;
+    for (PendingAttribute& attr : p_PendingAttributes) valueBytes += attr.Value.Length;
+    p_Decoded.clear();
+    p_Decoded.reserve(valueBytes);
+
+    for (PendingAttribute& attr : p_PendingAttributes)
+    {
+        string_view key = GetSpan(attr.Key);
+        if (p_Projection != nullptr && !p_ProjectedNode->KeepsAttribute(key)) continue;
+        p_Handler->OnAttribute(key, GetDecodedSpan(attr.Value));
+    }
+
+    NXML_TRACE_STAT(p_Stats.Elements++);
+    NXML_TRACE_STAT(p_Stats.Attributes += p_PendingAttributes.size());
+    NXML_TRACE_STAT(p_Stats.MaxDepth = std::max(p_Stats.MaxDepth, p_OpenElementOffsets.size()));
+
+    p_PendingAttributes.clear();
+}
+
+void nxml::Parser::CloseElement()
+{
+    if (p_OpenElementOffsets.empty())
+    {
+        return;
+    }
+
+    size_t offset = p_OpenElementOffsets.back();
+    p_OpenElementOffsets.pop_back();
+    if (!p_ProjectionStack.empty()) p_ProjectionStack.pop_back();
+
+    p_Handler->OnEndElement(string_view(p_OpenElementNames).substr(offset));
+    p_OpenElementNames.resize(offset);
+}
+
+void nxml::Parser::AssignElementValue()
+{
+    // ancestors kept only for the path to what was asked for drop their text
+    if (p_Projection != nullptr && !p_ProjectionStack.empty() && !p_ProjectionStack.back()->Whole)
+    {
+        return;
+    }
+
+    p_Decoded.clear();
+    p_Decoded.reserve(p_ElementValueSpan.Length);
+    p_Handler->OnText(GetDecodedSpan(p_ElementValueSpan));
+    NXML_TRACE_STAT(p_Stats.TextNodes++);
+}
+
+void nxml::Parser::CreateAttribute()
+{
+    // attributes are seen before we know the element type, so they are held until CreateElement
+    p_PendingAttributes.push_back(PendingAttribute{ p_AttributeNameSpan, p_AttributeValueSpan });
+}
+
+const char* nxml::Parser::GetModeName(nxml::Parser::Mode mode)
+{
+    switch(mode)
+    {
+        case Mode::Declaration:
+        return "Declaration";
+        case Mode::WaitForElementOpen:
+        return "WaitForElementOpen";
+        case Mode::ElementOpen:
+        return "ElementOpen";
+        case Mode::ElementClose:
+        return "ElementClose";
+        case Mode::WaitForAttribute:
+        return "WaitForAttribute";
+        case Mode::ElementAttributeName:
+        return "ElementAttributeName";
+        case Mode::ElementAttributeValue:
+        return "ElementAttributeValue";
+        case Mode::GetInnerElementType:
+        return "GetInnerElementType";
+        case Mode::ElementValue:
+        return "ElementValue";
+        case Mode::SkipElement:
+        return "SkipElement";
+        default:
+        return "Unknown Mode Type";
+    }
+}
+
+void nxml::Parser::SwitchMode(nxml::Parser::Mode newMode, char current)
+{
+#if NXML_TRACE < 2
+    // only the trace listener sees the character
+    (void)current;
+#endif
+#if NXML_TRACE
+    auto now = chrono::steady_clock::now();
+    p_Stats.ModeSeconds[static_cast<size_t>(p_Mode)] += chrono::duration<double>(now - p_ModeStart).count();
+    p_Stats.ModeSwitches[static_cast<size_t>(newMode)]++;
+    p_ModeStart = now;
+#if NXML_TRACE >= 2
+    if (p_TraceListener) p_TraceListener->OnModeSwitch(p_Mode, newMode, current);
+#endif
+#endif
+    p_Mode = newMode;
+}
+
+void nxml::Parser::ProcessCharacter(size_t charIndex)
+{
+    // no lookahead, the next character may not have arrived yet, decisions use the previous one instead
+    char c  = p_Source[charIndex];
+    char pc = p_PreviousChar;
+    p_PreviousChar = c;
+
+    switch(p_Mode)
+    {
+        case Mode::Declaration:
+            if(pc == '?' && c == '>') SwitchMode(Mode::WaitForElementOpen, c);
+            // no declaration, the document starts straight away with its root element
+            if(pc == '<' && c != '?')
+            {
+                SwitchMode(Mode::ElementOpen, c);
+                ProcessCharacter(charIndex);
+            }
+            break;
+        case Mode::WaitForElementOpen:
+            if(c != '<') return;
+            SwitchMode(Mode::ElementOpen, c);
+            break;
+        case Mode::ElementOpen:
+            // the name is complete, decide before any attribute is collected whether the element is wanted at all
+            if(p_Projection != nullptr && p_ElementNameSpan.Length > 0 && (c == '/' || c == '>' || isspace(static_cast<unsigned char>(c))) && !Project())
+            {
+                BeginSkip(charIndex);
+                return;
+            }
+            if(c == '/')
+            {
+                if (p_ElementNameSpan.Length > 0)
+                {
+                    // <name/>, nothing follows so open and close straight away
+                    CreateElement(Element::Type::Complex);
+                    CloseElement();
+                    ClearCurrentElement();
+                    SwitchMode(Mode::WaitForElementOpen, c);
+                    return;
+                }
+                SwitchMode(Mode::ElementClose, c);
+                return;
+            }
+            if(c == '>')
+            {
+                SwitchMode(Mode::GetInnerElementType, c);
+                return;
+            }
+            if(isspace(static_cast<unsigned char>(c)))
+            {
+                SwitchMode(Mode::WaitForAttribute, c);
+                return;
+            }
+            p_ElementNameSpan.Append(charIndex);
+            break;
+        case Mode::WaitForAttribute:
+            if(isspace(static_cast<unsigned char>(c))) return;
+            if(c == '>') 
+            {
+                SwitchMode(Mode::GetInnerElementType, c);
+                return;
+            }
+            if(c == '/')
+            {
+                // <name attr="value"/>
+                CreateElement(Element::Type::Complex);
+                CloseElement();
+                ClearCurrentElement();
+                SwitchMode(Mode::WaitForElementOpen, c);
+                return;
+            }
+            SwitchMode(Mode::ElementAttributeName, c);
+            p_AttributeNameSpan.Append(charIndex);
+            break;    
+        case Mode::ElementAttributeName:
+            if(c == '=') 
+            {
+                SwitchMode(Mode::ElementAttributeValue, c);
+                return;
+            }
+            if(c == '"' || c == '\'')
+            {
+                p_AttributeQuote = c;
+                SwitchMode(Mode::ElementAttributeValue, c);
+                return;
+            } 
+            if(isspace(static_cast<unsigned char>(c))) return;
+            // push char into attribute name span
+            p_AttributeNameSpan.Append(charIndex);
+            break;
+        case Mode::ElementAttributeValue:
+            if(p_AttributeQuote != '\0')
+            {
+                // quoted values run to the matching quote, spaces, '>' and '/' included
+                if(c == p_AttributeQuote)
+                {
+                    p_AttributeQuote = '\0';
+                    CreateAttribute();
+                    ClearCurrentAttribute();
+                    SwitchMode(Mode::WaitForAttribute, c);
+                    return;
+                }
+                p_AttributeValueSpan.Append(charIndex);
+                return;
+            }
+            if(c == '"' || c == '\'')
+            {
+                if(p_AttributeValueSpan.Length == 0) p_AttributeQuote = c;
+                return;
+            }
+            if(c == '=') return;
+            if(isspace(static_cast<unsigned char>(c)))
+            {
+                if(p_AttributeValueSpan.Length == 0) return;
+                CreateAttribute();
+                ClearCurrentAttribute();
+                SwitchMode(Mode::WaitForAttribute, c);
+                return;
+            }
+            if(c == '>')
+            {
+                CreateAttribute();
+                ClearCurrentAttribute();
+                SwitchMode(Mode::GetInnerElementType, c);
+                return;
+            }
+            // push char into attribute value span;
+            p_AttributeValueSpan.Append(charIndex);
+            break;
+        case Mode::ElementClose:
+            CloseElement();
+            ClearCurrentElement();
+            SwitchMode(Mode::WaitForElementOpen, c); 
+            break;
+        case Mode::GetInnerElementType:
+            if(isspace(static_cast<unsigned char>(c))) return;
+            if(c == '<')
+            {
+                CreateElement(Element::Type::Complex);
+                ClearCurrentElement();
+                SwitchMode(Mode::ElementOpen, c);
+                return;
+            }
+            CreateElement(Element::Type::Value);
+            p_ElementValueSpan.Append(charIndex);
+            SwitchMode(Mode::ElementValue, c);
+            break;
+        case Mode::ElementValue:
+            if(c == '<')
+            {
+                AssignElementValue();
+                SwitchMode(Mode::ElementClose, c);
+                return;
+            }
+            p_ElementValueSpan.Append(charIndex);
+            break;
+        case Mode::SkipElement:
+            SkipSubtree(p_Source.data() + charIndex, 1);
+            break;
+        default:
+            break;
+    }
+}
+
+bool nxml::Parser::Project()
+{
+    const Projection::Node& parent = p_ProjectionStack.empty() ? p_Projection->Root() : *p_ProjectionStack.back();
+    p_ProjectedNode = parent.Whole ? &parent : parent.Child(GetSpan(p_ElementNameSpan));
+    return p_ProjectedNode != nullptr;
+}
+
+void nxml::Parser::BeginSkip(size_t charIndex)
+{
+    // nothing of the skipped element is kept, so no span holds the window and Rebase carries nothing over
+    ClearCurrentElement();
+    NXML_TRACE_STAT(p_Stats.SkippedElements++);
+
+    // the start tag of the element is still being read, its '>' opens the subtree
+    p_SkipState = SkipState::Tag;
+    p_SkipTag = SkipTag::Open;
+    p_SkipDepth = 0;
+    p_SkipPrevious = '\0';
+    SwitchMode(Mode::SkipElement, p_Source[charIndex]);
+    SkipSubtree(p_Source.data() + charIndex, 1);
+}
+
+size_t nxml::Parser::SkipSubtree(const char* data, size_t size)
+{
+    size_t i = 0;
+    while (i < size)
+    {
+        switch (p_SkipState)
+        {
+            case SkipState::Content:
+                // text is never looked at, only the next tag matters
+                i += simd::FindChar(data + i, size - i, '<');
+                if (i == size) return size;
+                i++;
+                p_SkipState = SkipState::TagStart;
+                break;
+            case SkipState::TagStart:
+                p_SkipTag = data[i] == '/' ? SkipTag::Close : (data[i] == '?' || data[i] == '!') ? SkipTag::Other : SkipTag::Open;
+                p_SkipPrevious = data[i++];
+                p_SkipState = SkipState::Tag;
+                break;
+            case SkipState::Tag:
+            {
+                // tags are short, a plain loop finds the '>' that ends them, skipping over quoted values
+                size_t start = i;
+                while (i < size && data[i] != '>' && data[i] != '"' && data[i] != '\'') i++;
+                if (i > start) p_SkipPrevious = data[i - 1];
+                if (i == size) return size;
+
+                if (data[i] != '>')
+                {
+                    p_SkipQuote = data[i++];
+                    p_SkipState = SkipState::Quote;
+                    break;
+                }
+
+                i++;
+                p_SkipState = SkipState::Content;
+                if (p_SkipTag == SkipTag::Open && p_SkipPrevious != '/') p_SkipDepth++;
+                else if (p_SkipTag == SkipTag::Close && p_SkipDepth > 0) p_SkipDepth--;
+
+                if (p_SkipDepth == 0)
+                {
+                    SwitchMode(Mode::WaitForElementOpen, '>');
+                    return i;
+                }
+                break;
+            }
+            case SkipState::Quote:
+                i += simd::FindChar(data + i, size - i, p_SkipQuote);
+                if (i == size) return size;
+                i++;
+                p_SkipPrevious = p_SkipQuote;
+                p_SkipState = SkipState::Tag;
+                break;
+        }
+    }
+    return size;
+}
+
+void nxml::Parser::Begin(IParseHandler& handler)
+{
+    p_Mode = Mode::Declaration;
+    p_Handler = &handler;
+    p_Source = string_view();
+    p_Carry.clear();
+    p_Position = 0;
+    p_AttributeQuote = '\0';
+    p_PreviousChar = '\0';
+
+    ClearCurrentElement();
+    ClearCurrentAttribute();
+    p_PendingAttributes.clear();
+    p_OpenElementNames.clear();
+    p_OpenElementOffsets.clear();
+    p_ProjectionStack.clear();
+    p_ProjectedNode = nullptr;
+
+    NXML_TRACE_STAT(p_Stats = ParseStats());
+    NXML_TRACE_STAT(p_ParseStart = p_ModeStart = chrono::steady_clock::now());
+}
+
+void nxml::Parser::SetWindow(const char* data, size_t size)
+{
+    NXML_TRACE_STAT(p_Stats.Bytes += size);
+
+    if (p_Carry.empty())
+    {
+        // nothing left over from the previous chunk, parse the caller's memory directly
+        p_Source = string_view(data, size);
+        p_Position = 0;
+        return;
+    }
+
+    p_Carry.append(data, size);
+    p_Source = p_Carry;
+}
+
+bool nxml::Parser::Step()
+{
+    SkipRun();
+
+    if (p_Position >= p_Source.size())
+    {
+        return false;
+    }
+
+    ProcessCharacter(p_Position++);
+    return true;
+}
+
+void nxml::Parser::SkipRun()
+{
+    // in these modes every character up to the next delimiter would just be appended to a span,
+    // so find the delimiter with the scanner and take the whole run in one go
+    // an empty window may have a null data pointer, which the scanners must not see
+    if (p_Position >= p_Source.size()) return;
+
+    const char* data = p_Source.data() + p_Position;
+    size_t remaining = p_Source.size() - p_Position;
+    Span* span = nullptr;
+    size_t run = 0;
+
+    switch(p_Mode)
+    {
+        case Mode::WaitForElementOpen:
+            run = simd::FindChar(data, remaining, '<');
+            break;
+        case Mode::ElementOpen:
+            span = &p_ElementNameSpan;
+            run = simd::FindNameEnd(data, remaining);
+            break;
+        case Mode::ElementAttributeValue:
+            if (p_AttributeQuote == '\0') return;
+            span = &p_AttributeValueSpan;
+            run = simd::FindChar(data, remaining, p_AttributeQuote);
+            break;
+        case Mode::ElementValue:
+            span = &p_ElementValueSpan;
+            run = simd::FindChar(data, remaining, '<');
+            break;
+        case Mode::SkipElement:
+            run = SkipSubtree(data, remaining);
+            break;
+        default:
+            return;
+    }
+
+    if (run == 0)
+    {
+        return;
+    }
+
+    if (span != nullptr)
+    {
+        if (span->Length == 0) span->Begin = p_Position;
+        span->Length = p_Position + run - span->Begin;
+    }
+
+    p_PreviousChar = data[run - 1];
+    p_Position += run;
+}
+
+void nxml::Parser::Rebase()
+{
+    // keep everything from the earliest span still being collected, it continues in the next chunk
+    size_t keep = p_Source.size();
+    auto retain = [&keep](const Span& span) { if (span.Length > 0) keep = std::min(keep, span.Begin); };
+
+    retain(p_ElementNameSpan);
+    retain(p_ElementValueSpan);
+    retain(p_AttributeNameSpan);
+    retain(p_AttributeValueSpan);
+    for (PendingAttribute& attr : p_PendingAttributes)
+    {
+        retain(attr.Key);
+        retain(attr.Value);
+    }
+
+    if (p_Source.data() == p_Carry.data())
+    {
+        p_Carry.erase(0, keep);
+    }
+    else
+    {
+        p_Carry.assign(p_Source.substr(keep));
+    }
+
+    auto shift = [keep](Span& span) { if (span.Length > 0) span.Begin -= keep; };
+
+    shift(p_ElementNameSpan);
+    shift(p_ElementValueSpan);
+    shift(p_AttributeNameSpan);
+    shift(p_AttributeValueSpan);
+    for (PendingAttribute& attr : p_PendingAttributes)
+    {
+        shift(attr.Key);
+        shift(attr.Value);
+    }
+
+    p_Source = p_Carry;
+    p_Position = p_Carry.size();
+}
+
+void nxml::Parser::Feed(const char* data, size_t size)
+{
+    SetWindow(data, size);
+    while (Step()) {}
+    Rebase();
+}
+
+void nxml::Parser::Finish()
+{
+    // input ran out with elements still open, close them so handlers always see balanced events
+    while (!p_OpenElementOffsets.empty())
+    {
+        CloseElement();
+    }
+
+    p_Source = string_view();
+    p_Carry.clear();
+    p_Position = 0;
+
+#if NXML_TRACE
+    auto now = chrono::steady_clock::now();
+    p_Stats.ModeSeconds[static_cast<size_t>(p_Mode)] += chrono::duration<double>(now - p_ModeStart).count();
+    p_Stats.Seconds = chrono::duration<double>(now - p_ParseStart).count();
+    p_ModeStart = now;
+    if (p_TraceListener) p_TraceListener->OnParseComplete(p_Stats);
+#endif
+}
+
+void nxml::Parser::Parse(std::string_view xml, IParseHandler& handler)
+{
+    // the whole document is one chunk, nothing gets carried so views stay pointing into xml
+    Begin(handler);
+    Feed(xml.data(), xml.size());
+    Finish();
+}
+
+void nxml::Parser::Parse(ISource& source, IParseHandler& handler)
+{
+    // chunks are only borrowed for the duration of Feed, partial tokens are carried by the parser
+    const size_t chunkSize = 64 * 1024;
+    std::unique_ptr<char[]> chunk(new char[chunkSize]);
+
+    Begin(handler);
+    while (size_t size = source.Read(chunk.get(), chunkSize))
+    {
+        Feed(chunk.get(), size);
+    }
+    Finish();
+}
+
+void nxml::Parser::GetFromSource(ISource& source, Document& doc)
+{
+    p_DocumentBuilder.Recycle(doc);
+    p_DocumentBuilder.Doc = std::move(doc);
+
+    Parse(source, p_DocumentBuilder);
+    NXML_TRACE_STAT(p_DocumentBuilder.Doc.Stats = p_Stats);
+
+    doc = std::move(p_DocumentBuilder.Doc);
+}
+
+nxml::Document nxml::Parser::GetFromString(std::string& xml)
+{
+    Document doc;
+    GetFromString(xml, doc);
+    return doc;
+}
+
+void nxml::Parser::GetFromString(std::string_view xml, Document& doc)
+{
+    p_DocumentBuilder.Recycle(doc);
+    p_DocumentBuilder.Doc = std::move(doc);
+
+    Parse(xml, p_DocumentBuilder);
+    NXML_TRACE_STAT(p_DocumentBuilder.Doc.Stats = p_Stats);
+
+    doc = std::move(p_DocumentBuilder.Doc);
+}
+
+nxml::DocumentView nxml::Parser::GetViewFromString(std::string_view xml, std::shared_ptr<const void> sourceOwner)
+{
+    nxml::DocumentView doc(p_Names);
+    doc.Source = xml;
+    doc.p_SourceOwner = std::move(sourceOwner);
+
+    // every element has an opening '<' and (usually) a closing one, reserving up front
+    // keeps the pools from regrowing inside the arena
+    size_t tagCount = static_cast<size_t>(std::count(xml.begin(), xml.end(), '<'));
+    doc.p_Nodes->Nodes.reserve(tagCount / 2 + 1);
+    doc.p_Nodes->Source = xml;
+
+    DocumentViewBuilder builder(*doc.p_Nodes, this);
+    Parse(xml, builder);
+
+#if NXML_TRACE
+    doc.Stats = p_Stats;
+    doc.Stats.Allocations = doc.p_Nodes->Upstream.Allocations;
+    doc.Stats.AllocatedBytes = doc.p_Nodes->Upstream.Bytes;
+#endif
+
+    return doc;
+}
+
+std::string nxml::ParseStats::ToString() const
+{
+    static_assert(static_cast<size_t>(Parser::Mode::SkipElement) + 1 == ModeCount, "ModeCount must cover every Parser::Mode");
+
+    std::ostringstream out;
+    out << "bytes " << Bytes << ", elements " << Elements << ", attributes " << Attributes << ", text nodes " << TextNodes
+        << ", max depth " << MaxDepth << ", " << Seconds * 1000.0 << " ms";
+    if (SkippedElements != 0)
+    {
+        out << ", skipped subtrees " << SkippedElements;
+    }
+    if (Allocations != 0)
+    {
+        out << ", arena allocations " << Allocations << " (" << AllocatedBytes << " bytes)";
+    }
+    for (size_t i = 0; i < ModeCount; i++)
+    {
+        out << "\n    " << Parser::GetModeName(static_cast<Parser::Mode>(i)) << " : " << ModeSeconds[i] * 1000.0 << " ms, entered " << ModeSwitches[i] << " times";
+    }
+    return out.str();
+}
+
+void nxml::StreamTraceListener::OnModeSwitch(Parser::Mode from, Parser::Mode to, char current)
+{
+    p_Stream << "Switch Mode : Current Mode : " << Parser::GetModeName(from) << ", New Mode : " << Parser::GetModeName(to) << ", From Character : '" << current << "'\n";
+}
+
+void nxml::StreamTraceListener::OnParseComplete(const ParseStats& stats)
+{
+    p_Stream << "Parsed " << stats.ToString() << "\n";
+}
+
+namespace nxml
+{
+    static const size_t s_ReaderChunkSize = 64 * 1024;
+}
+
+nxml::Reader::Reader(std::string_view xml) : p_NextToken(0), p_Finished(false), p_Source(nullptr)
+{
+    p_Parser.Begin(*this);
+    p_Parser.SetWindow(xml.data(), xml.size());
+}
+
+nxml::Reader::Reader(ISource& source) : p_NextToken(0), p_Finished(false), p_Source(&source), p_Chunk(new char[s_ReaderChunkSize])
+{
+    p_Parser.Begin(*this);
+}
+
+bool nxml::Reader::Next(Token& token)
+{
+    // a single character can complete several tokens (an element and its attributes), queue them up
+    while (p_NextToken == p_Tokens.size())
+    {
+        p_Tokens.clear();
+        p_EndNames.clear();
+        p_NextToken = 0;
+
+        if (p_Parser.Step())
+        {
+            continue;
+        }
+
+        if (p_Source != nullptr && !p_Finished)
+        {
+            // chunk used up, keep the partly read token and continue with the next chunk
+            p_Parser.Rebase();
+            size_t size = p_Source->Read(p_Chunk.get(), s_ReaderChunkSize);
+            if (size > 0)
+            {
+                p_Parser.SetWindow(p_Chunk.get(), size);
+                continue;
+            }
+        }
+
+        if (p_Finished)
+        {
+            return false;
+        }
+
+        // end of input, let the parser close whatever is still open
+        p_Finished = true;
+        p_Parser.Finish();
+    }
+
+    token = p_Tokens[p_NextToken++];
+    return true;
+}
+
+void nxml::Reader::OnStartElement(std::string_view name, Element::Type elementType)
+{
+    if (p_Source == nullptr) p_OpenElements.push_back(name);
+    p_Tokens.push_back(Token{ TokenType::StartElement, elementType, name, string_view() });
+}
+
+void nxml::Reader::OnAttribute(std::string_view key, std::string_view value)
+{
+    p_Tokens.push_back(Token{ TokenType::Attribute, Element::Type::Invalid, key, value });
+}
+
+void nxml::Reader::OnText(std::string_view value)
+{
+    p_Tokens.push_back(Token{ TokenType::Text, Element::Type::Value, string_view(), value });
+}
+
+void nxml::Reader::OnEndElement(std::string_view name)
+{
+    if (p_Source != nullptr)
+    {
+        p_EndNames.emplace_back(name);
+        name = p_EndNames.back();
+    }
+    else
+    {
+        name = p_OpenElements.back();
+        p_OpenElements.pop_back();
+    }
+    p_Tokens.push_back(Token{ TokenType::EndElement, Element::Type::Invalid, name, string_view() });
+}
+
+void nxml::utils::CleanWhiteSpace(std::string& input)
+{
+    static std::regex e("[ \t]+");   // matches trailing whitespace
+    input.erase(std::remove(input.begin(), input.end(), '\r'), input.end());
+    input.erase(std::remove(input.begin(), input.end(), '\n'), input.cend());
+    input.erase(std::remove(input.begin(), input.end(), '\t'), input.end());
+
+    input = std::regex_replace(input, e, " $2"); // replace all trailing space wioth single space.
+    
+}
+
+std::string nxml::utils::LoadFileAsString(const char* path) {
+    std::string str;
+    LoadFileAsString(path, str);
+    return str;
+}
+
+bool nxml::utils::LoadFileAsString(const char* path, std::string& str) {
+    str.clear();
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+    {
+        return false;
+    }
+
+    // size the string once and read it in bulk rather than a character at a time
+    file.seekg(0, std::ios::end);
+    std::streamoff size = file.tellg();
+    if (size > 0)
+    {
+        str.resize(static_cast<size_t>(size));
+        file.seekg(0, std::ios::beg);
+        file.read(&str[0], size);
+        str.resize(static_cast<size_t>(file.gcount()));
+    }
+    else
+    {
+        // not seekable, fall back to streaming it in
+        file.clear();
+        file.seekg(0, std::ios::beg);
+        str.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+
+    MemorySource compressed(str);
+    std::unique_ptr<ISource> decompressor = OpenDecompressor(compressed, DetectCompression(std::string_view(str).substr(0, 4)));
+    if (decompressor)
+    {
+        std::string decompressed;
+        char chunk[64 * 1024];
+        while (size_t count = decompressor->Read(chunk, sizeof(chunk)))
+        {
+            decompressed.append(chunk, count);
+        }
+
+        // a truncated or damaged stream ends early, half a document is not returned as if it were all of it
+        if (decompressor->Failed())
+        {
+            str.clear();
+            return false;
+        }
+        str = std::move(decompressed);
+    }
+    return true;
+}
+
+bool nxml::utils::SaveStringToFile(const char* path, std::string & str) {
+    Compression compression = CompressionForPath(path);
+    if (compression != Compression::None)
+    {
+        FILE* file = std::fopen(path, "wb");
+        if (file == nullptr)
+        {
+            return false;
+        }
+
+        bool encoded = false;
+        {
+            FileSink fileSink(file);
+            std::unique_ptr<ISink> compressor = OpenCompressor(fileSink, compression);
+            if (compressor)
+            {
+                compressor->Write(str.data(), str.size());
+                // the trailer is written here, its errors count as well
+                compressor->Finish();
+                encoded = !compressor->Failed();
+            }
+        }
+
+        bool ok = encoded && std::ferror(file) == 0;
+        return std::fclose(file) == 0 && ok;
+    }
+
+    std::ofstream out(path);
+    out << str;
+    out.close();
+    return !out.fail();
+}
+
+nxml::Parser& nxml::ThreadParser()
+{
+    thread_local Parser parser;
+    return parser;
+}
+
+nxml::Document nxml::ParseString(std::string& input)
+{
+    return ThreadParser().GetFromString(input);
+}
+
+nxml::Document nxml::ParseProjected(std::string_view input, const Projection& projection)
+{
+    // the thread parser outlives this call, so the projection is cleared on every way out, a parse error included
+    struct ProjectionScope
+    {
+        Parser& Target;
+        ProjectionScope(Parser& parser, const Projection& projection) : Target(parser) { Target.SetProjection(&projection); }
+        ~ProjectionScope() { Target.SetProjection(nullptr); }
+    };
+
+    Parser& parser = ThreadParser();
+    ProjectionScope scope(parser, projection);
+
+    Document doc;
+    parser.GetFromString(input, doc);
+    return doc;
+}
+
+void nxml::ParseString(std::string_view input, Document& doc)
+{
+    ThreadParser().GetFromString(input, doc);
+}
+
+void nxml::ParseString(std::string_view input, IParseHandler& handler)
+{
+    // the handler may parse again from its callbacks, so it gets a parser of its own
+    nxml::Parser parser;
+    parser.Parse(input, handler);
+}
+
+nxml::DocumentView nxml::ParseView(std::string_view input)
+{
+    return ThreadParser().GetViewFromString(input);
+}
+
+nxml::DocumentView nxml::ParseView(std::string&& input)
+{
+    auto source = std::make_shared<const std::string>(std::move(input));
+    return ThreadParser().GetViewFromString(*source, source);
+}
+
+nxml::MappedFile::MappedFile(const char* path) : p_Data(nullptr), p_Size(0), p_Valid(false), p_Mapped(false), p_MappingHandle(nullptr)
+{
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        return;
+    }
+
+    LARGE_INTEGER size;
+    if (GetFileSizeEx(file, &size) && size.QuadPart > 0)
+    {
+        HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mapping != nullptr)
+        {
+            void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+            if (view != nullptr)
+            {
+                p_Data = static_cast<const char*>(view);
+                p_Size = static_cast<size_t>(size.QuadPart);
+                p_MappingHandle = mapping;
+                p_Mapped = true;
+                p_Valid = true;
+            }
+            else
+            {
+                CloseHandle(mapping);
+            }
+        }
+    }
+    CloseHandle(file);
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        return;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0)
+    {
+        void* view = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        if (view != MAP_FAILED)
+        {
+            // the parser walks the file front to back, let the kernel read ahead aggressively
+            madvise(view, static_cast<size_t>(info.st_size), MADV_SEQUENTIAL);
+            madvise(view, static_cast<size_t>(info.st_size), MADV_WILLNEED);
+
+            p_Data = static_cast<const char*>(view);
+            p_Size = static_cast<size_t>(info.st_size);
+            p_Mapped = true;
+            p_Valid = true;
+        }
+    }
+    close(fd);
+#endif
+
+    if (!p_Mapped)
+    {
+        ReadFallback(path);
+    }
+}
+
+nxml::MappedFile::~MappedFile()
+{
+    if (!p_Mapped)
+    {
+        return;
+    }
+
+#ifdef _WIN32
+    UnmapViewOfFile(p_Data);
+    CloseHandle(static_cast<HANDLE>(p_MappingHandle));
+#else
+    munmap(const_cast<char*>(p_Data), p_Size);
+#endif
+}
+
+void nxml::MappedFile::ReadFallback(const char* path)
+{
+#ifdef _WIN32
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open())
+    {
+        return;
+    }
+    p_Buffer.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        return;
+    }
+
+    // size may be unknown (pipes, /proc), grow the buffer as data arrives
+    size_t used = 0;
+    p_Buffer.resize(64 * 1024);
+    for (;;)
+    {
+        if (used == p_Buffer.size()) p_Buffer.resize(p_Buffer.size() * 2);
+
+        ssize_t count = read(fd, &p_Buffer[used], p_Buffer.size() - used);
+        if (count < 0)
+        {
+            if (errno == EINTR) continue;
+            close(fd);
+            p_Buffer.clear();
+            return;
+        }
+        if (count == 0) break;
+        used += static_cast<size_t>(count);
+    }
+    close(fd);
+    p_Buffer.resize(used);
+#endif
+
+    p_Data = p_Buffer.data();
+    p_Size = p_Buffer.size();
+    p_Valid = true;
+}
+
+nxml::BufferedSink::BufferedSink(size_t bufferSize) : p_Buffer(new char[bufferSize]), p_Capacity(bufferSize), p_Used(0)
+{
+
+}
+
+void nxml::BufferedSink::Write(const char* data, size_t size)
+{
+    if (p_Used + size > p_Capacity)
+    {
+        Flush();
+
+        // too big to be worth buffering, pass it straight through
+        if (size >= p_Capacity)
+        {
+            WriteOut(data, size);
+            return;
+        }
+    }
+
+    std::memcpy(p_Buffer.get() + p_Used, data, size);
+    p_Used += size;
+}
+
+void nxml::BufferedSink::Flush()
+{
+    if (p_Used == 0)
+    {
+        return;
+    }
+
+    WriteOut(p_Buffer.get(), p_Used);
+    p_Used = 0;
+}
+
+void nxml::FileSink::WriteOut(const char* data, size_t size)
+{
+    std::fwrite(data, 1, size, p_File);
+}
+
+void nxml::FdSink::WriteOut(const char* data, size_t size)
+{
+    while (size > 0)
+    {
+#ifdef _WIN32
+        int count = _write(p_Fd, data, static_cast<unsigned int>(size));
+#else
+        ssize_t count = ::write(p_Fd, data, size);
+        if (count < 0 && errno == EINTR) continue;
+#endif
+        if (count <= 0) return;
+        data += count;
+        size -= static_cast<size_t>(count);
+    }
+}
+
+size_t nxml::MemorySource::Read(char* data, size_t size)
+{
+    size = std::min(size, p_Data.size());
+    std::memcpy(data, p_Data.data(), size);
+    p_Data.remove_prefix(size);
+    return size;
+}
+
+size_t nxml::StreamSource::Read(char* data, size_t size)
+{
+    p_Stream.read(data, static_cast<std::streamsize>(size));
+    return static_cast<size_t>(p_Stream.gcount());
+}
+
+nxml::AsyncSource::AsyncSource(ISource& source, size_t blockSize, size_t blockCount)
+    : p_Source(source), p_BlockSize(blockSize), p_BlockCount(std::max<size_t>(1, blockCount)), p_Offset(0), p_Finished(false), p_Stopping(false)
+{
+    p_Thread = std::thread([this]() { ReadLoop(); });
+}
+
+nxml::AsyncSource::~AsyncSource()
+{
+    {
+        std::lock_guard<std::mutex> lock(p_Mutex);
+        p_Stopping = true;
+    }
+    p_Changed.notify_all();
+    p_Thread.join();
+}
+
+void nxml::AsyncSource::ReadLoop()
+{
+    size_t allocated = 0;
+    for (;;)
+    {
+        std::string block;
+        {
+            // wait for a spent block to come back, or for room to allocate one more
+            std::unique_lock<std::mutex> lock(p_Mutex);
+            p_Changed.wait(lock, [this, allocated]() { return p_Stopping || !p_Free.empty() || allocated < p_BlockCount; });
+            if (p_Stopping) return;
+
+            if (!p_Free.empty())
+            {
+                block = std::move(p_Free.back());
+                p_Free.pop_back();
+            }
+            else
+            {
+                allocated++;
+            }
+        }
+
+        // filled outside the lock, this is where the decompression runs
+        block.resize(p_BlockSize);
+        size_t size = p_Source.Read(&block[0], block.size());
+        block.resize(size);
+
+        {
+            std::lock_guard<std::mutex> lock(p_Mutex);
+            if (size == 0)
+            {
+                p_Finished = true;
+            }
+            else
+            {
+                p_Ready.push_back(std::move(block));
+            }
+        }
+        p_Changed.notify_all();
+
+        if (size == 0) return;
+    }
+}
+
+size_t nxml::AsyncSource::Read(char* data, size_t size)
+{
+    std::unique_lock<std::mutex> lock(p_Mutex);
+    p_Changed.wait(lock, [this]() { return p_Finished || !p_Ready.empty(); });
+    if (p_Ready.empty())
+    {
+        return 0;
+    }
+
+    std::string& block = p_Ready.front();
+    size = std::min(size, block.size() - p_Offset);
+    std::memcpy(data, block.data() + p_Offset, size);
+    p_Offset += size;
+
+    if (p_Offset == block.size())
+    {
+        p_Free.push_back(std::move(block));
+        p_Ready.pop_front();
+        p_Offset = 0;
+        lock.unlock();
+        p_Changed.notify_all();
+    }
+    return size;
+}
+
+nxml::AsyncSink::AsyncSink(ISink& sink, size_t blockSize, size_t blockCount)
+    : p_Sink(sink), p_BlockSize(blockSize), p_BlockCount(std::max<size_t>(1, blockCount)), p_Writing(false), p_Stopping(false)
+{
+    p_Current.reserve(p_BlockSize);
+    p_Thread = std::thread([this]() { WriteLoop(); });
+}
+
+nxml::AsyncSink::~AsyncSink()
+{
+    HandOver();
+    {
+        std::lock_guard<std::mutex> lock(p_Mutex);
+        p_Stopping = true;
+    }
+    p_Changed.notify_all();
+    p_Thread.join();
+}
+
+void nxml::AsyncSink::Write(const char* data, size_t size)
+{
+    while (size > 0)
+    {
+        size_t count = std::min(size, p_BlockSize - p_Current.size());
+        p_Current.append(data, count);
+        data += count;
+        size -= count;
+
+        if (p_Current.size() == p_BlockSize)
+        {
+            HandOver();
+        }
+    }
+}
+
+void nxml::AsyncSink::HandOver()
+{
+    if (p_Current.empty())
+    {
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(p_Mutex);
+    // blocks in flight bound the memory used, wait for the writer to catch up
+    p_Changed.wait(lock, [this]() { return p_Ready.size() < p_BlockCount; });
+    p_Ready.push_back(std::move(p_Current));
+
+    if (!p_Free.empty())
+    {
+        p_Current = std::move(p_Free.back());
+        p_Free.pop_back();
+    }
+    else
+    {
+        p_Current = std::string();
+        p_Current.reserve(p_BlockSize);
+    }
+    lock.unlock();
+    p_Changed.notify_all();
+}
+
+void nxml::AsyncSink::Flush()
+{
+    HandOver();
+
+    std::unique_lock<std::mutex> lock(p_Mutex);
+    p_Changed.wait(lock, [this]() { return p_Ready.empty() && !p_Writing; });
+    // the writer thread is idle until the next hand over, the sink can be used from here
+    p_Sink.Flush();
+}
+
+void nxml::AsyncSink::WriteLoop()
+{
+    std::unique_lock<std::mutex> lock(p_Mutex);
+    for (;;)
+    {
+        p_Changed.wait(lock, [this]() { return p_Stopping || !p_Ready.empty(); });
+        if (p_Ready.empty())
+        {
+            return;
+        }
+
+        std::string block = std::move(p_Ready.front());
+        p_Ready.pop_front();
+        p_Writing = true;
+        lock.unlock();
+
+        p_Sink.Write(block.data(), block.size());
+        block.clear();
+
+        lock.lock();
+        p_Writing = false;
+        p_Free.push_back(std::move(block));
+        p_Changed.notify_all();
+    }
+}
+
+nxml::Compression nxml::DetectCompression(std::string_view head)
+{
+    if (head.size() >= 2 && static_cast<unsigned char>(head[0]) == 0x1f && static_cast<unsigned char>(head[1]) == 0x8b)
+    {
+        return Compression::Gzip;
+    }
+    if (head.size() >= 4 && head.substr(0, 4) == std::string_view("\x28\xb5\x2f\xfd", 4))
+    {
+        return Compression::Zstd;
+    }
+    return Compression::None;
+}
+
+nxml::Compression nxml::CompressionForPath(const char* path)
+{
+    std::string_view name(path);
+    auto endsWith = [name](std::string_view suffix) { return name.size() >= suffix.size() && name.substr(name.size() - suffix.size()) == suffix; };
+
+    if (endsWith(".gz")) return Compression::Gzip;
+    if (endsWith(".zst")) return Compression::Zstd;
+    return Compression::None;
+}
+
+std::unique_ptr<nxml::ISource> nxml::OpenDecompressor(ISource& source, Compression compression)
+{
+#if !NXML_ZLIB && !NXML_ZSTD
+    (void)source;
+#endif
+    switch (compression)
+    {
+#if NXML_ZLIB
+        case Compression::Gzip:
+            return std::make_unique<GzipSource>(source);
+#endif
+#if NXML_ZSTD
+        case Compression::Zstd:
+            return std::make_unique<ZstdSource>(source);
+#endif
+        default:
+            return nullptr;
+    }
+}
+
+std::unique_ptr<nxml::ISink> nxml::OpenCompressor(ISink& sink, Compression compression)
+{
+#if !NXML_ZLIB && !NXML_ZSTD
+    (void)sink;
+#endif
+    switch (compression)
+    {
+#if NXML_ZLIB
+        case Compression::Gzip:
+            return std::make_unique<GzipSink>(sink);
+#endif
+#if NXML_ZSTD
+        case Compression::Zstd:
+            return std::make_unique<ZstdSink>(sink);
+#endif
+        default:
+            return nullptr;
+    }
+}
+
+#if NXML_ZLIB
+namespace nxml
+{
+    static const size_t s_GzipBlockSize = 64 * 1024;
+}
+
+nxml::GzipSource::GzipSource(ISource& source) : p_Source(source), p_Input(new char[s_GzipBlockSize]), p_InputEnded(false), p_Finished(false), p_Failed(false)
+{
+    std::memset(&p_Stream, 0, sizeof(p_Stream));
+    // 32 on top of the window bits detects gzip and zlib headers
+    if (inflateInit2(&p_Stream, 15 + 32) != Z_OK)
+    {
+        p_Failed = true;
+    }
+}
+
+nxml::GzipSource::~GzipSource()
+{
+    inflateEnd(&p_Stream);
+}
+
+size_t nxml::GzipSource::Read(char* data, size_t size)
+{
+    p_Stream.next_out = reinterpret_cast<Bytef*>(data);
+    p_Stream.avail_out = static_cast<uInt>(std::min<size_t>(size, UINT32_MAX));
+
+    while (p_Stream.avail_out > 0 && !p_Failed)
+    {
+        if (p_Stream.avail_in == 0 && !p_InputEnded)
+        {
+            size_t count = p_Source.Read(p_Input.get(), s_GzipBlockSize);
+            p_InputEnded = count == 0;
+            p_Stream.next_in = reinterpret_cast<Bytef*>(p_Input.get());
+            p_Stream.avail_in = static_cast<uInt>(count);
+        }
+
+        if (p_Finished)
+        {
+            // another gzip member follows the one that ended, as written by cat a.gz b.gz
+            if (p_Stream.avail_in == 0) break;
+            inflateReset(&p_Stream);
+            p_Finished = false;
+        }
+
+        int result = inflate(&p_Stream, Z_NO_FLUSH);
+        if (result == Z_STREAM_END)
+        {
+            p_Finished = true;
+        }
+        else if (result == Z_BUF_ERROR)
+        {
+            // no progress without more input, and there is none: the stream was cut off
+            p_Failed = p_InputEnded;
+        }
+        else if (result != Z_OK)
+        {
+            p_Failed = true;
+        }
+    }
+
+    return size - p_Stream.avail_out;
+}
+
+nxml::GzipSink::GzipSink(ISink& sink, int level) : p_Sink(sink), p_Output(new char[s_GzipBlockSize]), p_Finished(false), p_Failed(false)
+{
+    std::memset(&p_Stream, 0, sizeof(p_Stream));
+    // 16 on top of the window bits writes a gzip header and trailer instead of zlib's
+    if (deflateInit2(&p_Stream, level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+    {
+        p_Failed = true;
+    }
+}
+
+nxml::GzipSink::~GzipSink()
+{
+    Finish();
+    deflateEnd(&p_Stream);
+}
+
+void nxml::GzipSink::Write(const char* data, size_t size)
+{
+    NXML_ASSERT(!p_Finished, "GzipSink written to after Finish");
+    Deflate(data, size, Z_NO_FLUSH);
+}
+
+void nxml::GzipSink::Flush()
+{
+    if (!p_Finished)
+    {
+        Deflate(nullptr, 0, Z_SYNC_FLUSH);
+    }
+    p_Sink.Flush();
+}
+
+void nxml::GzipSink::Finish()
+{
+    if (p_Finished)
+    {
+        return;
+    }
+
+    Deflate(nullptr, 0, Z_FINISH);
+    p_Finished = true;
+    p_Sink.Flush();
+}
+
+void nxml::GzipSink::Deflate(const char* data, size_t size, int flush)
+{
+    if (p_Failed)
+    {
+        return;
+    }
+
+    do
+    {
+        uInt count = static_cast<uInt>(std::min<size_t>(size, UINT32_MAX));
+        p_Stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+        p_Stream.avail_in = count;
+        data += count;
+        size -= count;
+        int mode = size > 0 ? Z_NO_FLUSH : flush;
+
+        // keep going while deflate fills the output block, a partly filled one means it has caught up
+        do
+        {
+            p_Stream.next_out = reinterpret_cast<Bytef*>(p_Output.get());
+            p_Stream.avail_out = static_cast<uInt>(s_GzipBlockSize);
+            // Z_BUF_ERROR only means there was nothing to do
+            int result = deflate(&p_Stream, mode);
+            if (result != Z_OK && result != Z_STREAM_END && result != Z_BUF_ERROR)
+            {
+                p_Failed = true;
+                return;
+            }
+
+            size_t produced = s_GzipBlockSize - p_Stream.avail_out;
+            if (produced > 0) p_Sink.Write(p_Output.get(), produced);
+        } while (p_Stream.avail_out == 0);
+    } while (size > 0);
+}
+#endif
+
+#if NXML_ZSTD
+nxml::ZstdSource::ZstdSource(ISource& source)
+    : p_Source(source), p_Stream(ZSTD_createDStream()), p_InputSize(ZSTD_DStreamInSize()), p_InputEnded(false), p_FrameEnded(false), p_Failed(false)
+{
+    p_Input.reset(new char[p_InputSize]);
+    p_Pending = ZSTD_inBuffer{ p_Input.get(), 0, 0 };
+    if (p_Stream == nullptr || ZSTD_isError(ZSTD_initDStream(p_Stream)))
+    {
+        p_Failed = true;
+    }
+}
+
+nxml::ZstdSource::~ZstdSource()
+{
+    ZSTD_freeDStream(p_Stream);
+}
+
+size_t nxml::ZstdSource::Read(char* data, size_t size)
+{
+    ZSTD_outBuffer output{ data, size, 0 };
+
+    while (output.pos < output.size && !p_Failed)
+    {
+        bool inputEmpty = p_Pending.pos == p_Pending.size;
+        if (inputEmpty && !p_InputEnded)
+        {
+            size_t count = p_Source.Read(p_Input.get(), p_InputSize);
+            p_InputEnded = count == 0;
+            p_Pending = ZSTD_inBuffer{ p_Input.get(), count, 0 };
+            continue;
+        }
+        if (inputEmpty && p_FrameEnded)
+        {
+            break;
+        }
+
+        // returns 0 at the end of a frame, further frames are decoded as a continuation
+        size_t produced = output.pos;
+        size_t hint = ZSTD_decompressStream(p_Stream, &output, &p_Pending);
+        p_FrameEnded = hint == 0;
+
+        // an error, or the input ran out in the middle of a frame
+        p_Failed = ZSTD_isError(hint) || (inputEmpty && !p_FrameEnded && output.pos == produced);
+    }
+    return output.pos;
+}
+
+nxml::ZstdSink::ZstdSink(ISink& sink, int level)
+    : p_Sink(sink), p_Stream(ZSTD_createCStream()), p_OutputSize(ZSTD_CStreamOutSize()), p_Finished(false), p_Failed(false)
+{
+    p_Output.reset(new char[p_OutputSize]);
+    if (p_Stream == nullptr || ZSTD_isError(ZSTD_initCStream(p_Stream, level)))
+    {
+        p_Failed = true;
+    }
+}
+
+nxml::ZstdSink::~ZstdSink()
+{
+    Finish();
+    ZSTD_freeCStream(p_Stream);
+}
+
+void nxml::ZstdSink::Write(const char* data, size_t size)
+{
+    NXML_ASSERT(!p_Finished, "ZstdSink written to after Finish");
+    Compress(data, size, ZSTD_e_continue);
+}
+
+void nxml::ZstdSink::Flush()
+{
+    if (!p_Finished)
+    {
+        Compress(nullptr, 0, ZSTD_e_flush);
+    }
+    p_Sink.Flush();
+}
+
+void nxml::ZstdSink::Finish()
+{
+    if (p_Finished)
+    {
+        return;
+    }
+
+    Compress(nullptr, 0, ZSTD_e_end);
+    p_Finished = true;
+    p_Sink.Flush();
+}
+
+void nxml::ZstdSink::Compress(const char* data, size_t size, ZSTD_EndDirective mode)
+{
+    if (p_Failed)
+    {
+        return;
+    }
+
+    ZSTD_inBuffer input{ data, size, 0 };
+    for (;;)
+    {
+        ZSTD_outBuffer output{ p_Output.get(), p_OutputSize, 0 };
+        size_t remaining = ZSTD_compressStream2(p_Stream, &output, &input, mode);
+        if (output.pos > 0) p_Sink.Write(p_Output.get(), output.pos);
+
+        if (ZSTD_isError(remaining))
+        {
+            p_Failed = true;
+            return;
+        }
+        // continue is done once the input is taken, flush and end once nothing is left buffered
+        if (mode == ZSTD_e_continue ? input.pos == input.size : remaining == 0) return;
+    }
+}
+#endif
+
+nxml::Serializer::Serializer(ISink& sink, WhiteSpace whiteSpace) : p_Sink(sink), p_WhiteSpace(whiteSpace), p_Used(0)
+{
+
+}
+
+nxml::Serializer::~Serializer()
+{
+    Flush();
+}
+
+void nxml::Serializer::Flush()
+{
+    if (p_Used > 0)
+    {
+        p_Sink.Write(p_Buffer, p_Used);
+        p_Used = 0;
+    }
+    p_Sink.Flush();
+}
+
+void nxml::Serializer::Put(char c)
+{
+    if (p_Used == sizeof(p_Buffer))
+    {
+        p_Sink.Write(p_Buffer, p_Used);
+        p_Used = 0;
+    }
+    p_Buffer[p_Used++] = c;
+}
+
+void nxml::Serializer::Put(std::string_view text)
+{
+    if (p_Used + text.size() > sizeof(p_Buffer))
+    {
+        p_Sink.Write(p_Buffer, p_Used);
+        p_Used = 0;
+
+        if (text.size() > sizeof(p_Buffer))
+        {
+            p_Sink.Write(text.data(), text.size());
+            return;
+        }
+    }
+
+    std::memcpy(p_Buffer + p_Used, text.data(), text.size());
+    p_Used += text.size();
+}
+
+void nxml::Serializer::PutText(std::string_view text)
+{
+    if (p_WhiteSpace != WhiteSpace::Collapse)
+    {
+        // most values have nothing to escape, one scan finds that out and they are copied as they are
+        size_t i = 0;
+        while (i < text.size())
+        {
+            size_t special = i + simd::FindEscape(text.data() + i, text.size() - i);
+            Put(text.substr(i, special - i));
+            if (special == text.size()) break;
+
+            Put(EscapeFor(text[special]));
+            i = special + 1;
+        }
+        return;
+    }
+
+    // same result as utils::CleanWhiteSpace over the finished output, but copying whole runs
+    // between the characters that get dropped or escaped
+    bool lastWasSpace = false;
+    size_t runStart = 0;
+    for (size_t i = 0; i < text.size(); i++)
+    {
+        char c = text[i];
+        const char* escape = EscapeFor(c);
+        bool drop = c == '\r' || c == '\n' || c == '\t' || (c == ' ' && lastWasSpace);
+        if (drop || escape != nullptr)
+        {
+            Put(text.substr(runStart, i - runStart));
+            runStart = i + 1;
+            if (escape != nullptr)
+            {
+                Put(escape);
+                lastWasSpace = false;
+            }
+            continue;
+        }
+        lastWasSpace = c == ' ';
+    }
+    Put(text.substr(runStart));
+}
+
+nxml::XmlWriter::XmlWriter(ISink& sink, bool declaration) : p_Sink(sink), p_TagOpen(false), p_HasContent(false), p_HasRoot(false), p_Used(0)
+{
+    if (declaration)
+    {
+        Put(Declaration().ToString());
+    }
+}
+
+nxml::XmlWriter::~XmlWriter()
+{
+    NXML_ASSERT(p_Open.empty(), "XmlWriter destroyed with elements still open");
+    CloseTag();
+    Flush();
+}
+
+void nxml::XmlWriter::StartElement(std::string_view name)
+{
+    NXML_ASSERT(!name.empty(), "element name is empty");
+    NXML_ASSERT(!p_Open.empty() || !p_HasRoot, "second root element");
+    NXML_ASSERT(p_Open.empty() || !p_HasContent, "element mixes text and child elements");
+
+    CloseTag();
+    Put('<');
+    Put(name);
+
+    p_Open.push_back(p_Names.size());
+    p_Names.append(name);
+    p_TagOpen = true;
+    p_HasContent = false;
+    p_HasRoot = true;
+}
+
+void nxml::XmlWriter::EndElement()
+{
+    NXML_ASSERT(!p_Open.empty(), "EndElement without an open element");
+    if (p_Open.empty())
+    {
+        return;
+    }
+
+    CloseTag();
+    Put("</");
+    Put(std::string_view(p_Names).substr(p_Open.back()));
+    Put('>');
+
+    p_Names.resize(p_Open.back());
+    p_Open.pop_back();
+    p_HasContent = false;
+}
+
+void nxml::XmlWriter::EndElement(std::string_view name)
+{
+    NXML_ASSERT(!p_Open.empty() && std::string_view(p_Names).substr(p_Open.back()) == name, "EndElement does not match the open element");
+    (void)name;
+    EndElement();
+}
+
+void nxml::XmlWriter::Attribute(std::string_view key, std::string_view value)
+{
+    NXML_ASSERT(p_TagOpen, "Attribute must directly follow StartElement or another Attribute");
+    if (!p_TagOpen)
+    {
+        return;
+    }
+
+    Put(' ');
+    Put(key);
+    Put("=\"");
+    PutText(value);
+    Put('"');
+}
+
+void nxml::XmlWriter::Text(std::string_view value)
+{
+    NXML_ASSERT(!p_Open.empty(), "Text outside of an element");
+    CloseTag();
+    PutText(value);
+    p_HasContent = true;
+}
+
+void nxml::XmlWriter::Flush()
+{
+    if (p_Used > 0)
+    {
+        p_Sink.Write(p_Buffer, p_Used);
+        p_Used = 0;
+    }
+    p_Sink.Flush();
+}
+
+void nxml::XmlWriter::CloseTag()
+{
+    if (p_TagOpen)
+    {
+        Put('>');
+        p_TagOpen = false;
+    }
+}
+
+void nxml::XmlWriter::Put(char c)
+{
+    if (p_Used == sizeof(p_Buffer))
+    {
+        p_Sink.Write(p_Buffer, p_Used);
+        p_Used = 0;
+    }
+    p_Buffer[p_Used++] = c;
+}
+
+void nxml::XmlWriter::Put(std::string_view text)
+{
+    if (p_Used + text.size() > sizeof(p_Buffer))
+    {
+        p_Sink.Write(p_Buffer, p_Used);
+        p_Used = 0;
+
+        if (text.size() > sizeof(p_Buffer))
+        {
+            p_Sink.Write(text.data(), text.size());
+            return;
+        }
+    }
+
+    std::memcpy(p_Buffer + p_Used, text.data(), text.size());
+    p_Used += text.size();
+}
+
+void nxml::XmlWriter::PutText(std::string_view text)
+{
+    size_t i = 0;
+    while (i < text.size())
+    {
+        size_t special = i + simd::FindEscape(text.data() + i, text.size() - i);
+        Put(text.substr(i, special - i));
+        if (special == text.size()) break;
+
+        Put(EscapeFor(text[special]));
+        i = special + 1;
+    }
+}
+
+void nxml::Serializer::Write(const Document& doc)
+{
+    Declaration decl = doc.Decl;
+    Put(decl.ToString());
+
+    for (const Element& e : doc.RootElements)
+    {
+        Write(e);
+    }
+}
+
+void nxml::Serializer::Write(const Element& element)
+{
+    if (element.ElementType == Element::Type::Invalid)
+    {
+        return;
+    }
+
+    Put('<');
+    Put(element.ElementName);
+    for (const Attribute& attr : element.Attributes)
+    {
+        Put(' ');
+        Put(attr.Key);
+        Put("=\"");
+        PutText(attr.SerializedValue);
+        Put('"');
+    }
+    Put('>');
+
+    if (element.ElementType == Element::Type::Complex)
+    {
+        for (const Element& inner : element.InnerElements)
+        {
+            Write(inner);
+        }
+    }
+    else
+    {
+        PutText(element.InnerValue);
+    }
+
+    Put("</");
+    Put(element.ElementName);
+    Put('>');
+}
+
+void nxml::Serializer::Write(const DocumentView& doc)
+{
+    const NodeArena& nodes = *doc.RootElements().Arena();
+    bool hasSpans = nodes.FirstRoot != NodeArena::None && nodes.Nodes[nodes.FirstRoot].SourceBegin != NodeArena::None
+        && nodes.Nodes[nodes.LastRoot].SourceEnd != NodeArena::None;
+
+    if (p_WhiteSpace == WhiteSpace::Original && hasSpans)
+    {
+        if (nodes.Dirty.empty())
+        {
+            Put(nodes.Source);
+            return;
+        }
+
+        // declaration and anything else ahead of the first root, between the roots and after the last one is kept as is
+        p_Source = nodes.Source;
+        WriteOriginalChildren(doc.RootElements(), 0, p_Source.size());
+        p_Source = std::string_view();
+        return;
+    }
+
+    Declaration decl = doc.Decl;
+    Put(decl.ToString());
+
+    for (ElementView e : doc.RootElements())
+    {
+        Write(e);
+    }
+}
+
+void nxml::Serializer::Write(ElementView element)
+{
+    if (element.ElementType() == Element::Type::Invalid)
+    {
+        return;
+    }
+
+    Put('<');
+    Put(element.ElementName());
+    for (AttributeView attr : element.Attributes())
+    {
+        Put(' ');
+        Put(attr.Key);
+        Put("=\"");
+        PutText(attr.SerializedValue);
+        Put('"');
+    }
+    Put('>');
+
+    if (element.ElementType() == Element::Type::Complex)
+    {
+        for (ElementView inner : element.InnerElements())
+        {
+            Write(inner);
+        }
+    }
+    else
+    {
+        PutText(element.InnerValue());
+    }
+
+    Put("</");
+    Put(element.ElementName());
+    Put('>');
+}
+
+void nxml::Serializer::WriteOriginal(ElementView element)
+{
+    std::string_view text = element.SourceText();
+    if (!text.empty() && !element.IsDirty())
+    {
+        Put(text);
+        return;
+    }
+
+    Put('<');
+    Put(element.ElementName());
+    for (AttributeView attr : element.Attributes())
+    {
+        Put(' ');
+        Put(attr.Key);
+        Put("=\"");
+        PutText(attr.SerializedValue);
+        Put('"');
+    }
+    Put('>');
+
+    if (element.ElementType() == Element::Type::Complex)
+    {
+        // the source between the start and end tag keeps comments, processing instructions and indentation around the children
+        size_t from = std::string_view::npos;
+        size_t to = std::string_view::npos;
+        if (!text.empty())
+        {
+            // '>' may appear inside quoted attribute values
+            size_t openEnd = 0;
+            char quote = '\0';
+            for (; openEnd < text.size(); openEnd++)
+            {
+                char c = text[openEnd];
+                if (quote != '\0')
+                {
+                    if (c == quote) quote = '\0';
+                }
+                else if (c == '"' || c == '\'') quote = c;
+                else if (c == '>') break;
+            }
+
+            // a self closing element has no content to keep
+            size_t close = text.rfind('<');
+            if (close != std::string_view::npos && close > openEnd)
+            {
+                size_t begin = static_cast<size_t>(text.data() - p_Source.data());
+                from = begin + openEnd + 1;
+                to = begin + close;
+            }
+        }
+        WriteOriginalChildren(element.InnerElements(), from, to);
+    }
+    else
+    {
+        PutText(element.InnerValue());
+    }
+
+    Put("</");
+    Put(element.ElementName());
+    Put('>');
+}
+
+void nxml::Serializer::WriteOriginalChildren(ElementRange children, size_t from, size_t to)
+{
+    size_t cursor = from;
+    for (ElementView child : children)
+    {
+        std::string_view text = child.SourceText();
+        if (cursor != std::string_view::npos && !text.empty())
+        {
+            size_t begin = static_cast<size_t>(text.data() - p_Source.data());
+            Put(p_Source.substr(cursor, begin - cursor));
+            cursor = begin + text.size();
+        }
+        WriteOriginal(child);
+    }
+
+    if (cursor != std::string_view::npos)
+    {
+        Put(p_Source.substr(cursor, to - cursor));
+    }
+}
+
+namespace nxml
+{
+    // pool and queue of the worker running on this thread, so tasks it submits stay on its own queue
+    static thread_local const ThreadPool* t_WorkerPool = nullptr;
+    static thread_local size_t t_WorkerIndex = 0;
+}
+
+nxml::ThreadPool::ThreadPool(size_t threadCount) : p_Pending(0), p_NextQueue(0), p_Stopping(false)
+{
+    if (threadCount == 0)
+    {
+        threadCount = std::max<size_t>(1, std::thread::hardware_concurrency());
+    }
+
+    for (size_t i = 0; i < threadCount; i++)
+    {
+        p_Queues.emplace_back(std::make_unique<WorkerQueue>());
+    }
+    for (size_t i = 0; i < threadCount; i++)
+    {
+        p_Threads.emplace_back([this, i]() { WorkerLoop(i); });
+    }
+}
+
+nxml::ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(p_Mutex);
+        p_Stopping = true;
+    }
+    p_TaskAvailable.notify_all();
+
+    for (std::thread& t : p_Threads)
+    {
+        t.join();
+    }
+}
+
+std::future<void> nxml::ThreadPool::Submit(std::function<void()> task)
+{
+    std::packaged_task<void()> packaged(std::move(task));
+    std::future<void> result = packaged.get_future();
+
+    size_t queue = t_WorkerPool == this ? t_WorkerIndex : p_NextQueue.fetch_add(1, std::memory_order_relaxed) % p_Queues.size();
+    {
+        // counted under the queue lock, so the TryPop that takes the task can never decrement p_Pending first
+        std::lock_guard<std::mutex> lock(p_Queues[queue]->Mutex);
+        p_Pending.fetch_add(1, std::memory_order_release);
+        p_Queues[queue]->Tasks.emplace_back(std::move(packaged));
+    }
+
+    // taking the lock orders this against a worker that checked p_Pending and is about to sleep
+    {
+        std::lock_guard<std::mutex> lock(p_Mutex);
+    }
+    p_TaskAvailable.notify_one();
+    return result;
+}
+
+nxml::ThreadPool& nxml::ThreadPool::Shared()
+{
+    static ThreadPool pool;
+    return pool;
+}
+
+bool nxml::ThreadPool::IsWorkerThread() const
+{
+    return t_WorkerPool == this;
+}
+
+bool nxml::ThreadPool::RunPendingTask()
+{
+    std::packaged_task<void()> task;
+    if (!TryPop(IsWorkerThread() ? t_WorkerIndex : 0, task))
+    {
+        return false;
+    }
+
+    task();
+    return true;
+}
+
+void nxml::ThreadPool::WaitAll(std::vector<std::future<void>>& futures)
+{
+    bool help = IsWorkerThread();
+    std::exception_ptr failure;
+
+    for (std::future<void>& f : futures)
+    {
+        // with nothing left to run, whatever is outstanding is already running on another thread and blocking is safe
+        while (help && f.wait_for(std::chrono::seconds(0)) != std::future_status::ready && RunPendingTask()) {}
+
+        try
+        {
+            f.get();
+        }
+        catch (...)
+        {
+            if (!failure) failure = std::current_exception();
+        }
+    }
+
+    if (failure) std::rethrow_exception(failure);
+}
+
+bool nxml::ThreadPool::TryPop(size_t worker, std::packaged_task<void()>& task)
+{
+    {
+        WorkerQueue& own = *p_Queues[worker];
+        std::lock_guard<std::mutex> lock(own.Mutex);
+        if (!own.Tasks.empty())
+        {
+            task = std::move(own.Tasks.back());
+            own.Tasks.pop_back();
+            p_Pending.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+
+    for (size_t i = 1; i < p_Queues.size(); i++)
+    {
+        WorkerQueue& victim = *p_Queues[(worker + i) % p_Queues.size()];
+        std::lock_guard<std::mutex> lock(victim.Mutex);
+        if (!victim.Tasks.empty())
+        {
+            task = std::move(victim.Tasks.front());
+            victim.Tasks.pop_front();
+            p_Pending.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    return false;
+}
+
+void nxml::ThreadPool::WorkerLoop(size_t worker)
+{
+    t_WorkerPool = this;
+    t_WorkerIndex = worker;
+
+    for (;;)
+    {
+        std::packaged_task<void()> task;
+        if (TryPop(worker, task))
+        {
+            task();
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(p_Mutex);
+        p_TaskAvailable.wait(lock, [this]() { return p_Stopping || p_Pending.load(std::memory_order_acquire) > 0; });
+
+        // queued tasks still run when stopping, the pool only exits once they are gone
+        if (p_Pending.load(std::memory_order_acquire) == 0)
+        {
+            return;
+        }
+    }
+}
+
+namespace nxml {
+
+    /// <summary>
+    /// Byte ranges found by the parallel pre-scan: the root start tag and each of its direct children
+    /// </summary>
+    struct TopLevelLayout
+    {
+        size_t RootStart = 0;
+        size_t RootOpenEnd = 0;
+        vector<pair<size_t, size_t>> Children;
+    };
+
+    static size_t FindTagEnd(string_view xml, size_t from)
+    {
+        // '>' may legally appear inside quoted attribute values
+        char quote = '\0';
+        for (size_t i = from; i < xml.size(); i++)
+        {
+            char c = xml[i];
+            if (quote != '\0')
+            {
+                if (c == quote) quote = '\0';
+            }
+            else if (c == '"' || c == '\'') quote = c;
+            else if (c == '>') return i;
+        }
+        return string_view::npos;
+    }
+
+    static bool IsWhiteSpace(string_view text)
+    {
+        for (char c : text)
+        {
+            if (!isspace(static_cast<unsigned char>(c))) return false;
+        }
+        return true;
+    }
+
+    /// <summary>
+    /// Walks tags only (text is skipped with the delimiter scanner) to find where the root's children start and end.
+    /// Returns false for anything a split could change the meaning of, callers then parse serially.
+    /// </summary>
+    static bool ScanTopLevel(string_view xml, TopLevelLayout& layout)
+    {
+        size_t pos = 0;
+        for (;;)
+        {
+            pos += simd::FindChar(xml.data() + pos, xml.size() - pos, '<');
+            if (pos + 1 >= xml.size()) return false;
+            if (xml[pos + 1] == '!') return false;
+            if (xml[pos + 1] != '?') break;
+
+            size_t declarationEnd = xml.find("?>", pos);
+            if (declarationEnd == string_view::npos) return false;
+            pos = declarationEnd + 2;
+        }
+
+        layout.RootStart = pos;
+        layout.RootOpenEnd = FindTagEnd(xml, pos + 1);
+        if (layout.RootOpenEnd == string_view::npos || xml[layout.RootOpenEnd - 1] == '/') return false;
+
+        size_t depth = 0;
+        size_t childStart = 0;
+        size_t i = layout.RootOpenEnd + 1;
+        for (;;)
+        {
+            size_t lt = i + simd::FindChar(xml.data() + i, xml.size() - i, '<');
+            if (lt + 1 >= xml.size()) return false;
+
+            // text directly inside the root would make it a value element
+            if (depth == 0 && !IsWhiteSpace(xml.substr(i, lt - i))) return false;
+
+            char next = xml[lt + 1];
+            if (next == '!' || next == '?') return false;
+
+            size_t end = FindTagEnd(xml, lt + 1);
+            if (end == string_view::npos) return false;
+
+            if (next == '/')
+            {
+                if (depth == 0)
+                {
+                    // root closed, anything but whitespace after it means more roots
+                    return IsWhiteSpace(xml.substr(end + 1)) && !layout.Children.empty();
+                }
+                depth--;
+                if (depth == 0) layout.Children.emplace_back(childStart, end + 1);
+            }
+            else
+            {
+                if (depth == 0) childStart = lt;
+                if (xml[end - 1] == '/')
+                {
+                    if (depth == 0) layout.Children.emplace_back(lt, end + 1);
+                }
+                else
+                {
+                    depth++;
+                }
+            }
+            i = end + 1;
+        }
+    }
+}
+
+nxml::LazyDocument::LazyDocument() : p_State(std::make_unique<State>())
+{
+
+}
+
+nxml::LazyDocument nxml::LazyDocument::FromString(std::string_view xml, std::shared_ptr<const void> owner)
+{
+    LazyDocument doc;
+    // entries hold 32 bit offsets, larger inputs would wrap them and corrupt the index
+    if (xml.size() >= None) return doc;
+
+    doc.Source = xml;
+    doc.p_SourceOwner = std::move(owner);
+    doc.BuildIndex();
+    return doc;
+}
+
+void nxml::LazyDocument::BuildIndex()
+{
+    const char* data = Source.data();
+    size_t size = Source.size();
+    vector<Entry>& entries = p_State->Entries;
+    entries.reserve(static_cast<size_t>(std::count(Source.begin(), Source.end(), '<')) / 2 + 1);
+
+    // open elements and the last child linked under each, roots are linked through p_State->FirstRoot
+    struct Open
+    {
+        uint32_t Index;
+        uint32_t LastChild;
+    };
+    vector<Open> open;
+    uint32_t lastRoot = None;
+
+    auto skipTo = [&](size_t from, string_view terminator)
+    {
+        size_t end = Source.find(terminator, from);
+        return end == string_view::npos ? size : end + terminator.size();
+    };
+
+    size_t pos = 0;
+    while (pos < size)
+    {
+        size_t lt = pos + simd::FindChar(data + pos, size - pos, '<');
+        if (lt + 1 >= size) break;
+
+        char next = data[lt + 1];
+        if (next == '?')
+        {
+            pos = skipTo(lt + 2, "?>");
+            continue;
+        }
+        if (next == '!')
+        {
+            pos = Source.compare(lt, 4, "<!--") == 0 ? skipTo(lt + 4, "-->") : skipTo(lt + 2, ">");
+            continue;
+        }
+
+        size_t gt = lt + 1 + simd::FindChar(data + lt + 1, size - lt - 1, '>');
+        if (next == '/')
+        {
+            if (!open.empty())
+            {
+                entries[open.back().Index].Close = static_cast<uint32_t>(lt);
+                open.pop_back();
+            }
+            pos = gt + 1;
+            continue;
+        }
+
+        // '>' may sit inside a quoted attribute value, only then is the slower quote aware scan needed
+        if (gt < size && (std::memchr(data + lt, '"', gt - lt) != nullptr || std::memchr(data + lt, '\'', gt - lt) != nullptr))
+        {
+            gt = FindTagEnd(Source, lt);
+            if (gt == string_view::npos) gt = size;
+        }
+        if (gt >= size) break;
+
+        uint32_t index = static_cast<uint32_t>(entries.size());
+        bool selfClosing = data[gt - 1] == '/';
+        entries.push_back(Entry{ static_cast<uint32_t>(lt), static_cast<uint32_t>(gt), selfClosing ? static_cast<uint32_t>(gt) : static_cast<uint32_t>(size), None });
+
+        if (open.empty())
+        {
+            if (lastRoot == None) p_State->FirstRoot = index;
+            else entries[lastRoot].NextSibling = index;
+            lastRoot = index;
+        }
+        else
+        {
+            uint32_t& last = open.back().LastChild;
+            if (last != None) entries[last].NextSibling = index;
+            last = index;
+        }
+
+        if (!selfClosing) open.push_back(Open{ index, None });
+        pos = gt + 1;
+    }
+}
+
+nxml::Element::Type nxml::LazyDocument::TypeOf(uint32_t index) const
+{
+    // same rule as the parser: content starting with anything but '<' makes a value element
+    const Entry& entry = p_State->Entries[index];
+    if (entry.Close == entry.OpenEnd) return Element::Type::Complex;
+
+    for (size_t i = entry.OpenEnd + 1; i < entry.Close; i++)
+    {
+        if (!isspace(static_cast<unsigned char>(Source[i]))) return Source[i] == '<' ? Element::Type::Complex : Element::Type::Value;
+    }
+    return Element::Type::Complex;
+}
+
+uint32_t nxml::LazyDocument::FirstChild(uint32_t index) const
+{
+    const vector<Entry>& entries = p_State->Entries;
+    uint32_t next = index + 1;
+    if (next >= entries.size() || entries[next].Open >= entries[index].Close) return None;
+
+    // the parser keeps only the leading text of a value element, anything nested after it is dropped
+    return TypeOf(index) == Element::Type::Value ? None : next;
+}
+
+std::string_view nxml::LazyDocument::NameOf(uint32_t index) const
+{
+    const Entry& entry = p_State->Entries[index];
+    const char* start = Source.data() + entry.Open + 1;
+    size_t length = simd::FindNameEnd(start, entry.OpenEnd - entry.Open - 1);
+    return string_view(start, length);
+}
+
+const nxml::LazyDocument::Detail& nxml::LazyDocument::Materialize(uint32_t index) const
+{
+    State& state = *p_State;
+    if (state.Details.empty()) state.Details.resize(state.Entries.size());
+
+    Detail& detail = state.Details[index];
+    if (detail.Ready) return detail;
+
+    const Entry& entry = state.Entries[index];
+    detail.Ready = true;
+    state.Materialized++;
+
+    if (TypeOf(index) == Element::Type::Value)
+    {
+        size_t start = entry.OpenEnd + 1;
+        while (isspace(static_cast<unsigned char>(Source[start]))) start++;
+        size_t end = start + simd::FindChar(Source.data() + start, entry.Close - start, '<');
+        detail.Value = Decode(Source.substr(start, end - start));
+    }
+
+    // attributes between the name and the end of the start tag, values run to their matching quote
+    size_t i = entry.Open + 1 + NameOf(index).size();
+    size_t end = entry.OpenEnd;
+    auto isSpace = [&](size_t at) { return isspace(static_cast<unsigned char>(Source[at])) != 0; };
+
+    detail.FirstAttribute = static_cast<uint32_t>(state.Attributes.size());
+    while (true)
+    {
+        while (i < end && isSpace(i)) i++;
+        if (i >= end || Source[i] == '/') break;
+
+        size_t keyStart = i;
+        while (i < end && !isSpace(i) && Source[i] != '=' && Source[i] != '/') i++;
+        string_view key = Source.substr(keyStart, i - keyStart);
+
+        while (i < end && isSpace(i)) i++;
+        string_view value;
+        if (i < end && Source[i] == '=')
+        {
+            i++;
+            while (i < end && isSpace(i)) i++;
+            if (i < end && (Source[i] == '"' || Source[i] == '\''))
+            {
+                char quote = Source[i++];
+                size_t valueEnd = Source.find(quote, i);
+                if (valueEnd == string_view::npos || valueEnd > end) valueEnd = end;
+                value = Source.substr(i, valueEnd - i);
+                i = valueEnd + 1;
+            }
+            else
+            {
+                size_t valueStart = i;
+                while (i < end && !isSpace(i) && Source[i] != '/') i++;
+                value = Source.substr(valueStart, i - valueStart);
+            }
+        }
+        state.Attributes.push_back(AttributeView{ key, Decode(value) });
+    }
+    detail.AttributeCount = static_cast<uint32_t>(state.Attributes.size()) - detail.FirstAttribute;
+    return detail;
+}
+
+std::string_view nxml::LazyDocument::Decode(std::string_view text) const
+{
+    if (simd::FindChar(text.data(), text.size(), '&') == text.size()) return text;
+
+    string& decoded = p_State->Decoded.emplace_back();
+    DecodeEntities(text, decoded);
+    return decoded;
+}
+
+nxml::LazyElement nxml::LazyDocument::operator[](const char* key) const
+{
+    for (LazyElement e : RootElements())
+    {
+        if (e.ElementName() == key) return e;
+    }
+    return LazyElement::Invalid;
+}
+
+nxml::LazyElementRange nxml::LazyDocument::RootElements() const
+{
+    return LazyElementRange(this, p_State->FirstRoot);
+}
+
+size_t nxml::LazyDocument::IndexedCount() const
+{
+    return p_State->Entries.size();
+}
+
+size_t nxml::LazyDocument::MaterializedCount() const
+{
+    return p_State->Materialized;
+}
+
+nxml::Document nxml::LazyDocument::ToDocument() const
+{
+    Document doc;
+    for (LazyElement e : RootElements())
+    {
+        doc.RootElements.emplace_back(e.ToElement());
+    }
+    return doc;
+}
+
+const nxml::LazyElement nxml::LazyElement::Invalid = nxml::LazyElement();
+
+bool nxml::LazyElement::IsValid() const
+{
+    return p_Doc != nullptr && p_Index != LazyDocument::None;
+}
+
+nxml::Element::Type nxml::LazyElement::ElementType() const
+{
+    return IsValid() ? p_Doc->TypeOf(p_Index) : Element::Type::Invalid;
+}
+
+std::string_view nxml::LazyElement::ElementName() const
+{
+    return IsValid() ? p_Doc->NameOf(p_Index) : std::string_view();
+}
+
+std::string_view nxml::LazyElement::InnerValue() const
+{
+    return IsValid() ? p_Doc->Materialize(p_Index).Value : std::string_view();
+}
+
+nxml::LazyElementRange nxml::LazyElement::InnerElements() const
+{
+    return LazyElementRange(p_Doc, IsValid() ? p_Doc->FirstChild(p_Index) : LazyDocument::None);
+}
+
+nxml::LazyAttributeRange nxml::LazyElement::Attributes() const
+{
+    if (!IsValid()) return LazyAttributeRange(p_Doc, 0, 0);
+
+    const LazyDocument::Detail& detail = p_Doc->Materialize(p_Index);
+    return LazyAttributeRange(p_Doc, detail.FirstAttribute, detail.AttributeCount);
+}
+
+nxml::LazyElement nxml::LazyElement::operator[](const char* key) const
+{
+    // names come straight from the index, siblings that do not match are never materialised
+    for (LazyElement e : InnerElements())
+    {
+        if (e.ElementName() == key) return e;
+    }
+    return LazyElement::Invalid;
+}
+
+nxml::LazyElement nxml::LazyElement::operator[](const ElementWithAttribute& search) const
+{
+    for (LazyElement e : InnerElements())
+    {
+        if (e.ElementName() != search.ElementName) continue;
+
+        for (AttributeView attr : e.Attributes())
+        {
+            if (attr.Key == search.AttributeName && attr.SerializedValue == search.AttributeValue)
+            {
+                return e;
+            }
+        }
+    }
+    return LazyElement::Invalid;
+}
+
+nxml::Element nxml::LazyElement::ToElement() const
+{
+    Element e(ElementType());
+    e.ElementName = string(ElementName());
+    e.InnerValue = string(InnerValue());
+
+    for (AttributeView attr : Attributes())
+    {
+        Attribute a;
+        a.Key = string(attr.Key);
+        a.SerializedValue = string(attr.SerializedValue);
+        e.Attributes.push_back(a);
+    }
+
+    for (LazyElement inner : InnerElements())
+    {
+        e.InnerElements.emplace_back(inner.ToElement());
+    }
+    return e;
+}
+
+nxml::LazyElementRange::Iterator& nxml::LazyElementRange::Iterator::operator++()
+{
+    Index = Doc->p_State->Entries[Index].NextSibling;
+    return *this;
+}
+
+size_t nxml::LazyElementRange::size() const
+{
+    size_t count = 0;
+    for (auto it = begin(); it != end(); ++it) count++;
+    return count;
+}
+
+nxml::AttributeView nxml::LazyAttributeRange::Iterator::operator*() const
+{
+    return Doc->p_State->Attributes[Index];
+}
+
+nxml::LazyDocument nxml::ParseLazy(std::string_view input)
+{
+    return LazyDocument::FromString(input);
+}
+
+nxml::LazyDocument nxml::ParseLazy(std::string&& input)
+{
+    auto source = std::make_shared<const std::string>(std::move(input));
+    return LazyDocument::FromString(*source, source);
+}
+
+nxml::FrozenDocument::FrozenDocument(const Document& doc)
+{
+    NameMap names;
+    uint32_t previous = None;
+    for (const Element& e : doc.RootElements)
+    {
+        uint32_t root = AddElement(e, names);
+        if (previous != None) p_Nodes[previous].NextSibling = root;
+        previous = root;
+    }
+
+    NXML_ASSERT(p_Strings.size() < None, "Frozen documents are limited to 4GB of text");
+    p_Nodes.shrink_to_fit();
+    p_Attributes.shrink_to_fit();
+    p_Names.shrink_to_fit();
+    p_Strings.shrink_to_fit();
+
+    // the strings no longer move, so lookups can hash views and never allocate
+    p_NameIndex.reserve(p_Names.size());
+    for (uint32_t i = 0; i < p_Names.size(); i++)
+    {
+        p_NameIndex.emplace(NameOf(i), i);
+    }
+}
+
+uint32_t nxml::FrozenDocument::AddString(const string& value)
+{
+    uint32_t offset = static_cast<uint32_t>(p_Strings.size());
+    p_Strings.append(value);
+    return offset;
+}
+
+uint32_t nxml::FrozenDocument::AddName(const string& name, NameMap& names)
+{
+    auto found = names.find(name);
+    if (found != names.end()) return found->second;
+
+    uint32_t index = static_cast<uint32_t>(p_Names.size());
+    p_Names.push_back(NameRef{ AddString(name), static_cast<uint32_t>(name.size()) });
+    names.emplace(name, index);
+    return index;
+}
+
+uint32_t nxml::FrozenDocument::AddElement(const Element& e, NameMap& names)
+{
+    uint32_t index = static_cast<uint32_t>(p_Nodes.size());
+    p_Nodes.push_back(Node{ AddName(e.ElementName, names), e.ElementType, AddString(e.InnerValue), static_cast<uint32_t>(e.InnerValue.size()),
+        None, static_cast<uint32_t>(p_Attributes.size()), static_cast<uint32_t>(e.Attributes.size()), !e.InnerElements.empty() });
+
+    for (const nxml::Attribute& attr : e.Attributes)
+    {
+        p_Attributes.push_back(AttributeNode{ AddName(attr.Key, names), AddString(attr.SerializedValue), static_cast<uint32_t>(attr.SerializedValue.size()) });
+    }
+
+    uint32_t previous = None;
+    for (const Element& inner : e.InnerElements)
+    {
+        uint32_t child = AddElement(inner, names);
+        if (previous != None) p_Nodes[previous].NextSibling = child;
+        previous = child;
+    }
+    return index;
+}
+
+uint32_t nxml::FrozenDocument::FindName(std::string_view name) const
+{
+    auto found = p_NameIndex.find(name);
+    return found == p_NameIndex.end() ? None : found->second;
+}
+
+nxml::FrozenElement nxml::FrozenDocument::operator[](const char* key) const
+{
+    uint32_t name = FindName(key);
+    if (name == None) return FrozenElement();
+
+    for (uint32_t root = p_Nodes.empty() ? None : 0; root != None; root = p_Nodes[root].NextSibling)
+    {
+        if (p_Nodes[root].Name == name) return FrozenElement(this, root);
+    }
+    return FrozenElement();
+}
+
+size_t nxml::FrozenDocument::MemoryUsage() const
+{
+    return p_Nodes.capacity() * sizeof(Node) + p_Attributes.capacity() * sizeof(AttributeNode)
+        + p_Names.capacity() * sizeof(NameRef) + p_Strings.capacity();
+}
+
+nxml::Document nxml::FrozenDocument::ToDocument() const
+{
+    Document doc;
+    for (FrozenElement e : RootElements())
+    {
+        doc.RootElements.emplace_back(e.ToElement());
+    }
+    return doc;
+}
+
+nxml::Element::Type nxml::FrozenElement::ElementType() const
+{
+    return IsValid() ? p_Doc->p_Nodes[p_Index].ElementType : Element::Type::Invalid;
+}
+
+std::string_view nxml::FrozenElement::ElementName() const
+{
+    return IsValid() ? p_Doc->NameOf(p_Doc->p_Nodes[p_Index].Name) : std::string_view();
+}
+
+std::string_view nxml::FrozenElement::InnerValue() const
+{
+    if (!IsValid()) return std::string_view();
+
+    const FrozenDocument::Node& node = p_Doc->p_Nodes[p_Index];
+    return p_Doc->StringAt(node.Value, node.ValueLength);
+}
+
+nxml::FrozenElementRange nxml::FrozenElement::InnerElements() const
+{
+    bool hasChildren = IsValid() && p_Doc->p_Nodes[p_Index].HasChildren;
+    return FrozenElementRange(p_Doc, hasChildren ? p_Index + 1 : FrozenDocument::None);
+}
+
+nxml::FrozenAttributeRange nxml::FrozenElement::Attributes() const
+{
+    if (!IsValid()) return FrozenAttributeRange(p_Doc, 0, 0);
+
+    const FrozenDocument::Node& node = p_Doc->p_Nodes[p_Index];
+    return FrozenAttributeRange(p_Doc, node.FirstAttribute, node.AttributeCount);
+}
+
+std::string_view nxml::FrozenElement::Attribute(std::string_view key) const
+{
+    for (AttributeView attr : Attributes())
+    {
+        if (attr.Key == key) return attr.SerializedValue;
+    }
+    return std::string_view();
+}
+
+nxml::FrozenElement nxml::FrozenElement::operator[](const char* key) const
+{
+    // one hash to turn the key into a name index, siblings are then told apart by integer compares
+    uint32_t name = IsValid() ? p_Doc->FindName(key) : FrozenDocument::None;
+    if (name == FrozenDocument::None) return FrozenElement();
+
+    for (FrozenElement e : InnerElements())
+    {
+        if (p_Doc->p_Nodes[e.p_Index].Name == name) return e;
+    }
+    return FrozenElement();
+}
+
+nxml::FrozenElement nxml::FrozenElement::operator[](const ElementWithAttribute& search) const
+{
+    uint32_t name = IsValid() ? p_Doc->FindName(search.ElementName) : FrozenDocument::None;
+    if (name == FrozenDocument::None) return FrozenElement();
+
+    for (FrozenElement e : InnerElements())
+    {
+        if (p_Doc->p_Nodes[e.p_Index].Name != name) continue;
+
+        for (AttributeView attr : e.Attributes())
+        {
+            if (attr.Key == search.AttributeName && attr.SerializedValue == search.AttributeValue) return e;
+        }
+    }
+    return FrozenElement();
+}
+
+int64_t nxml::FrozenElement::AsInt(int64_t fallback) const
+{
+    int64_t value;
+    return IsValid() && DecodeInt(InnerValue(), value) ? value : fallback;
+}
+
+double nxml::FrozenElement::AsDouble(double fallback) const
+{
+    double value;
+    return IsValid() && DecodeDouble(InnerValue(), value) ? value : fallback;
+}
+
+bool nxml::FrozenElement::AsBool(bool fallback) const
+{
+    bool value;
+    return IsValid() && DecodeBool(InnerValue(), value) ? value : fallback;
+}
+
+nxml::Date nxml::FrozenElement::AsDate() const
+{
+    Date value;
+    Date::Parse(InnerValue(), value);
+    return value;
+}
+
+nxml::Element nxml::FrozenElement::ToElement() const
+{
+    Element e(ElementType());
+    e.ElementName = string(ElementName());
+    e.InnerValue = string(InnerValue());
+
+    for (AttributeView attr : Attributes())
+    {
+        nxml::Attribute a;
+        a.Key = string(attr.Key);
+        a.SerializedValue = string(attr.SerializedValue);
+        e.Attributes.push_back(std::move(a));
+    }
+
+    for (FrozenElement inner : InnerElements())
+    {
+        e.InnerElements.emplace_back(inner.ToElement());
+    }
+    return e;
+}
+
+nxml::FrozenElementRange::Iterator& nxml::FrozenElementRange::Iterator::operator++()
+{
+    Index = Doc->p_Nodes[Index].NextSibling;
+    return *this;
+}
+
+size_t nxml::FrozenElementRange::size() const
+{
+    size_t count = 0;
+    for (auto it = begin(); it != end(); ++it) count++;
+    return count;
+}
+
+nxml::AttributeView nxml::FrozenAttributeRange::Iterator::operator*() const
+{
+    const FrozenDocument::AttributeNode& attr = Doc->p_Attributes[Index];
+    return AttributeView{ Doc->NameOf(attr.Key), Doc->StringAt(attr.Value, attr.ValueLength) };
+}
+
+void nxml::FrozenDocumentHandle::Publish(std::shared_ptr<const FrozenDocument> doc)
+{
+    std::atomic_store_explicit(&p_Current, std::move(doc), std::memory_order_release);
+    // bumped after the store, a reader seeing the new version is guaranteed to load the new document
+    p_Version.fetch_add(1, std::memory_order_release);
+}
+
+std::shared_ptr<const nxml::FrozenDocument> nxml::FrozenDocumentHandle::Load() const
+{
+    return std::atomic_load_explicit(&p_Current, std::memory_order_acquire);
+}
+
+const nxml::FrozenDocument* nxml::FrozenDocumentHandle::Reader::Current()
+{
+    // the shared_ptr, and with it the reference count every reader would fight over, is only touched on a new version
+    uint64_t version = p_Handle.Version();
+    if (version != p_Version)
+    {
+        p_Snapshot = p_Handle.Load();
+        p_Version = version;
+    }
+    return p_Snapshot.get();
+}
+
+nxml::Document nxml::ParseParallel(std::string_view input, ThreadPool* pool)
+{
+    if (pool == nullptr)
+    {
+        pool = &ThreadPool::Shared();
+    }
+
+    TopLevelLayout layout;
+    if (pool->ThreadCount() < 2 || !ScanTopLevel(input, layout))
+    {
+        Document doc;
+        ThreadParser().GetFromString(input, doc);
+        return doc;
+    }
+
+    // a few chunks per thread evens out uneven children, but each chunk should be worth a task
+    size_t chunkTarget = std::max<size_t>(64 * 1024, input.size() / (pool->ThreadCount() * 4));
+
+    vector<pair<size_t, size_t>> chunks;
+    for (auto& child : layout.Children)
+    {
+        if (chunks.empty() || chunks.back().second - chunks.back().first >= chunkTarget)
+        {
+            chunks.push_back(child);
+        }
+        else
+        {
+            chunks.back().second = child.second;
+        }
+    }
+
+    vector<Document> parsed(chunks.size());
+    vector<future<void>> pending;
+    pending.reserve(chunks.size());
+    Document doc;
+    std::exception_ptr failure;
+
+    // the tasks reference locals, nothing may unwind past here before every one of them has finished
+    try
+    {
+        for (size_t i = 0; i < chunks.size(); i++)
+        {
+            pending.push_back(pool->Submit([&, i]()
+            {
+                ThreadParser().GetFromString(input.substr(chunks[i].first, chunks[i].second - chunks[i].first), parsed[i]);
+            }));
+        }
+
+        // the root on its own, start tag plus a close, gives its name and attributes
+        string rootXml(input.substr(layout.RootStart, layout.RootOpenEnd + 1 - layout.RootStart));
+        rootXml += "</>";
+        doc = ParseString(rootXml);
+    }
+    catch (...)
+    {
+        failure = std::current_exception();
+    }
+
+    pool->WaitAll(pending);
+    if (failure) std::rethrow_exception(failure);
+
+    Element& root = doc.RootElements.front();
+    root.InnerElements.reserve(layout.Children.size());
+    for (Document& chunk : parsed)
+    {
+        for (Element& e : chunk.RootElements)
+        {
+            root.InnerElements.emplace_back(std::move(e));
+        }
+    }
+    return doc;
+}
+
+std::string_view nxml::Schema::LocalName(std::string_view name) const
+{
+    if (name.size() > p_Prefix.size() && name.compare(0, p_Prefix.size(), p_Prefix) == 0)
+    {
+        return name.substr(p_Prefix.size());
+    }
+    return name;
+}
+
+std::string nxml::Schema::GetTypeName(SimpleType type)
+{
+    switch(type)
+    {
+        case SimpleType::String:
+        return "xs:string";
+        case SimpleType::Float:
+        return "xs:float";
+        case SimpleType::Double:
+        return "xs:double";
+        case SimpleType::Integer:
+        return "xs:integer";
+        case SimpleType::Boolean:
+        return "xs:boolean";
+        case SimpleType::Date:
+        return "xs:date";
+        default:
+        return "Unknown Type";
+    }
+}
+
+bool nxml::Schema::ResolveType(std::string_view typeName, const std::vector<std::string>& complexNames, ElementDecl& decl)
+{
+    for (size_t i = 0; i < complexNames.size(); i++)
+    {
+        if (complexNames[i] == typeName)
+        {
+            decl.ComplexType = static_cast<int>(i);
+            return true;
+        }
+    }
+
+    string_view local = LocalName(typeName);
+    if (local == "string" || local == "normalizedString" || local == "token") decl.Type = SimpleType::String;
+    else if (local == "float") decl.Type = SimpleType::Float;
+    else if (local == "double" || local == "decimal") decl.Type = SimpleType::Double;
+    else if (local == "int" || local == "integer" || local == "long" || local == "short") decl.Type = SimpleType::Integer;
+    else if (local == "boolean") decl.Type = SimpleType::Boolean;
+    else if (local == "date") decl.Type = SimpleType::Date;
+    else
+    {
+        Errors.push_back("unsupported type '" + string(typeName) + "'");
+        return false;
+    }
+    return true;
+}
+
+int nxml::Schema::CompileComplexType(const Element& element, const std::string& name, const std::vector<std::string>& complexNames)
+{
+    ComplexType type;
+    type.Name = name;
+
+    for (const Element& inner : element.InnerElements)
+    {
+        string_view kind = LocalName(inner.ElementName);
+        if (kind == "sequence")
+        {
+            for (const Element& particle : inner.InnerElements)
+            {
+                if (LocalName(particle.ElementName) != "element")
+                {
+                    Errors.push_back("unsupported particle '" + particle.ElementName + "' in sequence of '" + name + "'");
+                    continue;
+                }
+
+                ElementDecl decl;
+                if (CompileElement(particle, complexNames, decl)) type.Sequence.push_back(std::move(decl));
+            }
+        }
+        else if (kind == "attribute")
+        {
+            AttributeDecl attr;
+            ElementDecl typeHolder;
+            for (const Attribute& a : inner.Attributes)
+            {
+                if (a.Key == "name") attr.Name = a.SerializedValue;
+                else if (a.Key == "type" && ResolveType(a.SerializedValue, vector<string>(), typeHolder)) attr.Type = typeHolder.Type;
+                else if (a.Key == "use") attr.Required = a.SerializedValue == "required";
+            }
+            type.Attributes.push_back(std::move(attr));
+        }
+        else
+        {
+            Errors.push_back("unsupported content '" + inner.ElementName + "' in complexType '" + name + "'");
+        }
+    }
+
+    if (type.Attributes.size() > 64)
+    {
+        Errors.push_back("complexType '" + name + "' declares more than 64 attributes");
+    }
+
+    ComplexTypes.push_back(std::move(type));
+    return static_cast<int>(ComplexTypes.size() - 1);
+}
+
+bool nxml::Schema::CompileElement(const Element& element, const std::vector<std::string>& complexNames, ElementDecl& decl)
+{
+    bool typed = false;
+    vector<string> malformed;
+
+    // occurrence counts are non-negative integers, anything else is reported instead of being read as some number
+    auto readOccurs = [&malformed](const Attribute& a, uint32_t& out)
+    {
+        string_view text = TrimValue(a.SerializedValue);
+        uint32_t value = 0;
+        auto result = std::from_chars(text.data(), text.data() + text.size(), value);
+        if (text.empty() || result.ec != std::errc() || result.ptr != text.data() + text.size())
+        {
+            malformed.push_back(a.Key + " '" + a.SerializedValue + "'");
+            return;
+        }
+        out = value;
+    };
+
+    for (const Attribute& a : element.Attributes)
+    {
+        if (a.Key == "name") decl.Name = a.SerializedValue;
+        else if (a.Key == "type") typed = ResolveType(a.SerializedValue, complexNames, decl);
+        else if (a.Key == "minOccurs") readOccurs(a, decl.MinOccurs);
+        else if (a.Key == "maxOccurs" && TrimValue(a.SerializedValue) == "unbounded") decl.MaxOccurs = Unbounded;
+        else if (a.Key == "maxOccurs") readOccurs(a, decl.MaxOccurs);
+    }
+
+    for (const string& bad : malformed)
+    {
+        Errors.push_back("malformed " + bad + " on element '" + decl.Name + "'");
+    }
+    if (decl.MaxOccurs != Unbounded && decl.MinOccurs > decl.MaxOccurs)
+    {
+        Errors.push_back("minOccurs " + std::to_string(decl.MinOccurs) + " exceeds maxOccurs " + std::to_string(decl.MaxOccurs) + " on element '" + decl.Name + "'");
+    }
+
+    // anonymous type declared inline
+    for (const Element& inner : element.InnerElements)
+    {
+        if (LocalName(inner.ElementName) == "complexType")
+        {
+            decl.ComplexType = CompileComplexType(inner, string(), complexNames);
+            typed = true;
+        }
+    }
+
+    if (decl.Name.empty())
+    {
+        Errors.push_back("element declaration without a name");
+        return false;
+    }
+    return typed || decl.ComplexType >= 0 || decl.Type == SimpleType::String;
+}
+
+nxml::Schema nxml::Schema::FromString(std::string_view xsd)
+{
+    Schema schema;
+
+    DocumentBuilder builder;
+    nxml::Parser parser;
+    parser.Parse(xsd, builder);
+
+    if (builder.Doc.RootElements.empty())
+    {
+        schema.Errors.push_back("no schema element found");
+        return schema;
+    }
+
+    const Element& root = builder.Doc.RootElements.front();
+    size_t colon = root.ElementName.find(':');
+    schema.p_Prefix = colon == string::npos ? string() : root.ElementName.substr(0, colon + 1);
+
+    if (schema.LocalName(root.ElementName) != "schema")
+    {
+        schema.Errors.push_back("root element is '" + root.ElementName + "', expected schema");
+        return schema;
+    }
+
+    // named types can be referenced before they are declared, number them all first
+    vector<string> complexNames;
+    for (const Element& e : root.InnerElements)
+    {
+        if (schema.LocalName(e.ElementName) != "complexType") continue;
+        for (const Attribute& a : e.Attributes)
+        {
+            if (a.Key == "name") complexNames.push_back(a.SerializedValue);
+        }
+    }
+    // reserve their slots so indices match complexNames, anonymous types go after them
+    schema.ComplexTypes.resize(complexNames.size());
+
+    size_t named = 0;
+    for (const Element& e : root.InnerElements)
+    {
+        string_view kind = schema.LocalName(e.ElementName);
+        if (kind == "complexType")
+        {
+            int index = schema.CompileComplexType(e, complexNames[named], complexNames);
+            schema.ComplexTypes[named++] = std::move(schema.ComplexTypes[index]);
+            schema.ComplexTypes.pop_back();
+        }
+        else if (kind == "element")
+        {
+            ElementDecl decl;
+            if (schema.CompileElement(e, complexNames, decl)) schema.RootElements.push_back(std::move(decl));
+        }
+        else
+        {
+            schema.Errors.push_back("unsupported schema component '" + e.ElementName + "'");
+        }
+    }
+    return schema;
+}
+
+nxml::Schema nxml::Schema::FromFile(const char* path)
+{
+    MappedFile file(path);
+    if (!file.IsValid())
+    {
+        Schema schema;
+        schema.Errors.push_back(string("could not read '") + path + "'");
+        return schema;
+    }
+    return FromString(file.View());
+}
+
+bool nxml::Schema::IsValidValue(SimpleType type, std::string_view value)
+{
+    // simple types other than string collapse surrounding whitespace before checking
+    while (!value.empty() && isspace(static_cast<unsigned char>(value.front()))) value.remove_prefix(1);
+    while (!value.empty() && isspace(static_cast<unsigned char>(value.back()))) value.remove_suffix(1);
+
+    auto digits = [](string_view text, size_t& i) { size_t start = i; while (i < text.size() && isdigit(static_cast<unsigned char>(text[i]))) i++; return i - start; };
+
+    switch(type)
+    {
+        case SimpleType::String:
+            return true;
+        case SimpleType::Integer:
+        {
+            size_t i = 0;
+            if (i < value.size() && (value[i] == '+' || value[i] == '-')) i++;
+            return digits(value, i) > 0 && i == value.size();
+        }
+        case SimpleType::Float:
+        case SimpleType::Double:
+        {
+            if (value == "INF" || value == "-INF" || value == "+INF" || value == "NaN") return true;
+            size_t i = 0;
+            if (i < value.size() && (value[i] == '+' || value[i] == '-')) i++;
+            size_t mantissa = digits(value, i);
+            if (i < value.size() && value[i] == '.')
+            {
+                i++;
+                mantissa += digits(value, i);
+            }
+            if (mantissa == 0) return false;
+            if (i < value.size() && (value[i] == 'e' || value[i] == 'E'))
+            {
+                i++;
+                if (i < value.size() && (value[i] == '+' || value[i] == '-')) i++;
+                if (digits(value, i) == 0) return false;
+            }
+            return i == value.size();
+        }
+        case SimpleType::Boolean:
+            return value == "true" || value == "false" || value == "1" || value == "0";
+        case SimpleType::Date:
+        {
+            Date date;
+            return Date::Parse(value, date);
+        }
+        default:
+            return false;
+    }
+}
+
+nxml::ValidatingHandler::ValidatingHandler(const Schema& schema, IParseHandler* next) : p_Schema(schema), p_Next(next)
+{
+
+}
+
+void nxml::ValidatingHandler::AddError(std::string message)
+{
+    p_Errors.push_back(ValidationError{ p_Path, std::move(message) });
+}
+
+const nxml::Schema::ComplexType* nxml::ValidatingHandler::TypeOf(const Frame& frame) const
+{
+    if (frame.Decl == nullptr || frame.Decl->ComplexType < 0) return nullptr;
+    return &p_Schema.ComplexTypes[static_cast<size_t>(frame.Decl->ComplexType)];
+}
+
+const nxml::Schema::ElementDecl* nxml::ValidatingHandler::MatchChild(Frame& parent, std::string_view name)
+{
+    const Schema::ComplexType* type = TypeOf(parent);
+    if (type == nullptr)
+    {
+        return nullptr;
+    }
+
+    // find the next particle that accepts the name, an unknown name leaves the position untouched
+    size_t match = parent.Particle;
+    if (match < type->Sequence.size() && (type->Sequence[match].Name != name || parent.Count >= type->Sequence[match].MaxOccurs))
+    {
+        match++;
+    }
+    while (match < type->Sequence.size() && type->Sequence[match].Name != name)
+    {
+        match++;
+    }
+    if (match == type->Sequence.size())
+    {
+        return nullptr;
+    }
+
+    // particles skipped over must have had enough occurrences
+    for (; parent.Particle < match; parent.Particle++, parent.Count = 0)
+    {
+        const Schema::ElementDecl& particle = type->Sequence[parent.Particle];
+        if (parent.Count < particle.MinOccurs)
+        {
+            AddError("expected '" + particle.Name + "' before '" + string(name) + "'");
+        }
+    }
+
+    parent.Count++;
+    return &type->Sequence[match];
+}
+
+void nxml::ValidatingHandler::CheckSequenceComplete(Frame& frame)
+{
+    const Schema::ComplexType* type = TypeOf(frame);
+    if (type == nullptr)
+    {
+        return;
+    }
+
+    for (; frame.Particle < type->Sequence.size(); frame.Particle++, frame.Count = 0)
+    {
+        const Schema::ElementDecl& particle = type->Sequence[frame.Particle];
+        if (frame.Count < particle.MinOccurs)
+        {
+            AddError("missing '" + particle.Name + "'");
+        }
+    }
+
+    for (size_t i = 0; i < type->Attributes.size() && i < 64; i++)
+    {
+        if (type->Attributes[i].Required && (frame.SeenAttributes & (uint64_t(1) << i)) == 0)
+        {
+            AddError("missing required attribute '" + type->Attributes[i].Name + "'");
+        }
+    }
+}
+
+void nxml::ValidatingHandler::OnStartElement(std::string_view name, Element::Type elementType)
+{
+    size_t pathLength = p_Path.size();
+    if (!p_Path.empty()) p_Path += '/';
+    p_Path.append(name);
+
+    const Schema::ElementDecl* decl = nullptr;
+    if (p_Frames.empty())
+    {
+        for (const Schema::ElementDecl& root : p_Schema.RootElements)
+        {
+            if (root.Name == name) decl = &root;
+        }
+        if (decl == nullptr) AddError("no global declaration for '" + string(name) + "'");
+    }
+    else
+    {
+        Frame& parent = p_Frames.back();
+        if (parent.Decl != nullptr)
+        {
+            if (parent.Decl->ComplexType < 0)
+            {
+                AddError("element not allowed in simple content");
+            }
+            else
+            {
+                decl = MatchChild(parent, name);
+                if (decl == nullptr) AddError("unexpected element");
+            }
+        }
+    }
+
+    p_Frames.push_back(Frame{ decl, 0, 0, 0, pathLength, false });
+
+    if (p_Next) p_Next->OnStartElement(name, elementType);
+}
+
+void nxml::ValidatingHandler::OnAttribute(std::string_view key, std::string_view value)
+{
+    Frame& frame = p_Frames.back();
+    const Schema::ComplexType* type = TypeOf(frame);
+
+    // namespace declarations are not attributes as far as the schema is concerned
+    bool isNamespace = key == "xmlns" || key.substr(0, 6) == "xmlns:";
+
+    if (frame.Decl != nullptr && !isNamespace)
+    {
+        bool declared = false;
+        for (size_t i = 0; type != nullptr && i < type->Attributes.size(); i++)
+        {
+            const Schema::AttributeDecl& attr = type->Attributes[i];
+            if (attr.Name != key) continue;
+
+            declared = true;
+            if (i < 64) frame.SeenAttributes |= uint64_t(1) << i;
+            if (!Schema::IsValidValue(attr.Type, value))
+            {
+                AddError("attribute '" + string(key) + "' value '" + string(value) + "' is not a valid " + Schema::GetTypeName(attr.Type));
+            }
+        }
+        if (!declared) AddError("undeclared attribute '" + string(key) + "'");
+    }
+
+    if (p_Next) p_Next->OnAttribute(key, value);
+}
+
+void nxml::ValidatingHandler::OnText(std::string_view value)
+{
+    Frame& frame = p_Frames.back();
+    frame.HasText = true;
+
+    if (frame.Decl != nullptr)
+    {
+        if (frame.Decl->ComplexType >= 0)
+        {
+            AddError("text not allowed in complex content");
+        }
+        else if (!Schema::IsValidValue(frame.Decl->Type, value))
+        {
+            AddError("'" + string(value) + "' is not a valid " + Schema::GetTypeName(frame.Decl->Type));
+        }
+    }
+
+    if (p_Next) p_Next->OnText(value);
+}
+
+void nxml::ValidatingHandler::OnEndElement(std::string_view name)
+{
+    Frame& frame = p_Frames.back();
+
+    if (frame.Decl != nullptr)
+    {
+        if (frame.Decl->ComplexType >= 0)
+        {
+            CheckSequenceComplete(frame);
+        }
+        else if (!frame.HasText && !Schema::IsValidValue(frame.Decl->Type, string_view()))
+        {
+            AddError("empty value is not a valid " + Schema::GetTypeName(frame.Decl->Type));
+        }
+    }
+
+    p_Path.resize(frame.PathLength);
+    p_Frames.pop_back();
+
+    if (p_Next) p_Next->OnEndElement(name);
+}
+
+bool nxml::Validate(std::string_view input, const Schema& schema, std::vector<ValidationError>* errors)
+{
+    ValidatingHandler validator(schema);
+    nxml::Parser parser;
+    parser.Parse(input, validator);
+
+    if (errors != nullptr)
+    {
+        *errors = validator.Errors();
+    }
+    return validator.IsValid();
+}
+
+nxml::Document nxml::ParseValidated(std::string_view input, const Schema& schema, std::vector<ValidationError>& errors)
+{
+    DocumentBuilder builder;
+    ValidatingHandler validator(schema, &builder);
+    nxml::Parser parser;
+    parser.Parse(input, validator);
+
+    errors = validator.Errors();
+    return std::move(builder.Doc);
+}
+
+nxml::BindingHandler::BindingHandler(Binding root) : p_Root(root)
+{
+
+}
+
+void nxml::BindingHandler::OnStartElement(std::string_view name, Element::Type /* elementType */)
+{
+    if (p_Stack.empty())
+    {
+        // only the first root is bound, any others are skipped
+        p_Stack.push_back(p_BoundRoot ? Binding() : p_Root);
+        p_BoundRoot = true;
+        return;
+    }
+
+    const Binding& parent = p_Stack.back();
+    Binding child;
+    if (parent.Child == nullptr || !parent.Child(parent.Target, name, child))
+    {
+        child = Binding();
+    }
+    p_Stack.push_back(child);
+}
+
+void nxml::BindingHandler::OnAttribute(std::string_view key, std::string_view value)
+{
+    const Binding& owner = p_Stack.back();
+    Binding member;
+    if (owner.Child != nullptr && owner.Child(owner.Target, key, member) && member.Text != nullptr)
+    {
+        if (!member.Text(member.Target, value)) p_InvalidValues++;
+    }
+}
+
+void nxml::BindingHandler::OnText(std::string_view value)
+{
+    const Binding& owner = p_Stack.back();
+    if (owner.Text != nullptr && !owner.Text(owner.Target, value)) p_InvalidValues++;
+}
+
+void nxml::BindingHandler::OnEndElement(std::string_view /* name */)
+{
+    p_Stack.pop_back();
+}
+
+void nxml::Replay(const Element& element, IParseHandler& handler)
+{
+    handler.OnStartElement(element.ElementName, element.ElementType);
+    for (const Attribute& attr : element.Attributes)
+    {
+        handler.OnAttribute(attr.Key, attr.SerializedValue);
+    }
+    if (element.ElementType == Element::Type::Value)
+    {
+        handler.OnText(element.InnerValue);
+    }
+    for (const Element& inner : element.InnerElements)
+    {
+        Replay(inner, handler);
+    }
+    handler.OnEndElement(element.ElementName);
+}
+
+namespace nxml
+{
+    // parses the file's contents into doc, decompressing them first when they start with a known magic number.
+    // False, with doc emptied, when the compressed data is damaged or cut off
+    static bool ParseMappedFile(const MappedFile& file, Document& doc)
+    {
+        Compression compression = DetectCompression(file.View().substr(0, 4));
+        if (compression != Compression::None)
+        {
+            MemorySource compressed(file.View());
+            std::unique_ptr<ISource> decompressor = OpenDecompressor(compressed, compression);
+            if (decompressor)
+            {
+                {
+                    AsyncSource ahead(*decompressor);
+                    ThreadParser().GetFromSource(ahead, doc);
+                }
+
+                // checked once the reader thread is gone, the parser only saw the stream end early
+                if (decompressor->Failed())
+                {
+                    doc = Document();
+                    return false;
                 }
+                return true;
+            }
+        }
+
+        ThreadParser().GetFromString(file.View(), doc);
+        return true;
+    }
+}
+
+nxml::Document nxml::ParseFile(const char* path)
+{
+    MappedFile file(path);
+
+    Document doc;
+    ParseMappedFile(file, doc);
+    return doc;
+}
+
+nxml::Document nxml::ParseSource(ISource& source)
+{
+    Document doc;
+    ThreadParser().GetFromSource(source, doc);
+    return doc;
+}
+
+bool nxml::SaveFile(const Document& doc, const char* path, Serializer::WhiteSpace whiteSpace)
+{
+    FILE* file = std::fopen(path, "wb");
+    if (file == nullptr)
+    {
+        return false;
+    }
+
+    Compression compression = CompressionForPath(path);
+    bool encoded = true;
+    {
+        FileSink fileSink(file);
+        std::unique_ptr<ISink> compressor = OpenCompressor(fileSink, compression);
+        if (compressor)
+        {
+            {
+                // serializing on this thread, compressing on the writer's
+                AsyncSink behind(*compressor);
+                Serializer serializer(behind, whiteSpace);
+                serializer.Write(doc);
+                serializer.Flush();
+            }
+            // the trailer is written here, its errors count as well
+            compressor->Finish();
+            encoded = !compressor->Failed();
+        }
+        else if (compression != Compression::None)
+        {
+            // support for the path's format was not compiled in, plain xml under a .gz or .zst name would be a lie
+            encoded = false;
+        }
+        else
+        {
+            Serializer serializer(fileSink, whiteSpace);
+            serializer.Write(doc);
+        }
+    }
+
+    bool ok = encoded && std::ferror(file) == 0;
+    return std::fclose(file) == 0 && ok;
+}
+
+nxml::DocumentView nxml::ParseFileView(const char* path)
+{
+    auto file = std::make_shared<const MappedFile>(path);
+    return ThreadParser().GetViewFromString(file->View(), file);
+}
+
+
+namespace nxml
+{
+    /// <summary>
+    /// Layout of a binary snapshot: header, node table, attribute table, name table and string bytes.
+    /// Nodes are stored in pre-order, every section is 8 byte aligned and references strings by offset.
+    /// </summary>
+    struct BinaryString
+    {
+        uint64_t Offset;
+        uint64_t Length;
+    };
+
+    struct BinaryNode
+    {
+        uint32_t        Name;
+        uint32_t        ElementType;
+        uint32_t        FirstChild;
+        uint32_t        NextSibling;
+        uint32_t        FirstAttribute;
+        uint32_t        AttributeCount;
+        BinaryString    Value;
+    };
+
+    struct BinaryAttribute
+    {
+        uint32_t        Key;
+        uint32_t        Padding;
+        BinaryString    Value;
+    };
+
+    struct BinaryHeader
+    {
+        // bump Version whenever the layout changes, older snapshots are then treated as stale
+        static constexpr char       MagicValue[8] = { 'N', 'X', 'M', 'L', 'B', 'I', 'N', '\0' };
+        static constexpr uint32_t   CurrentVersion = 2;
+        // reads back byte swapped on a machine of the other endianness
+        static constexpr uint32_t   ByteOrderMark = 0x01020304;
+        // table entry sizes, a snapshot from a build that lays them out differently is stale as well
+        static constexpr uint32_t   LayoutValue = uint32_t(sizeof(BinaryNode)) | uint32_t(sizeof(BinaryAttribute)) << 8 | uint32_t(sizeof(BinaryString)) << 16;
+
+        char        Magic[8];
+        uint32_t    Version;
+        uint32_t    HeaderSize;
+        uint32_t    ByteOrder;
+        uint32_t    Layout;
+        uint64_t    SourceSize;
+        uint64_t    SourceHash;
+        uint32_t    NodeCount;
+        uint32_t    AttributeCount;
+        uint32_t    NameCount;
+        uint32_t    Padding;
+        uint64_t    StringBytes;
+        uint64_t    PayloadHash;
+    };
+
+    static uint64_t HashBytes(const char* data, size_t size)
+    {
+        // multiply-rotate hash over four independent lanes, it only has to catch stale or damaged files
+        // and must not take longer than reading the snapshot does
+        auto mix = [](uint64_t lane, uint64_t word)
+        {
+            lane ^= word * 0xBF58476D1CE4E5B9ull;
+            return ((lane << 27) | (lane >> 37)) * 0x94D049BB133111EBull;
+        };
+
+        uint64_t lanes[4] = { 0x9E3779B97F4A7C15ull ^ size, 0xC2B2AE3D27D4EB4Full, 0x165667B19E3779F9ull, 0x27D4EB2F165667C5ull };
+        size_t i = 0;
+        for (; i + 32 <= size; i += 32)
+        {
+            uint64_t words[4];
+            std::memcpy(words, data + i, 32);
+            for (int lane = 0; lane < 4; lane++) lanes[lane] = mix(lanes[lane], words[lane]);
+        }
+
+        uint64_t hash = lanes[0] ^ mix(lanes[1], lanes[2]) ^ mix(lanes[3], size);
+        for (; i < size; i++)
+        {
+            hash = (hash ^ static_cast<unsigned char>(data[i])) * 0x100000001B3ull;
+        }
+        return hash ^ (hash >> 31);
+    }
+
+    /// <summary>
+    /// Checked view over the sections of a mapped snapshot
+    /// </summary>
+    struct BinarySnapshot
+    {
+        const BinaryHeader*     Header = nullptr;
+        const BinaryNode*       Nodes = nullptr;
+        const BinaryAttribute*  Attributes = nullptr;
+        const BinaryString*     Names = nullptr;
+        string_view             Strings;
+
+        // source is checked against the snapshot's hash unless null, an empty source is checked like any other
+        bool Open(string_view file, const string_view* source)
+        {
+            if (file.size() < sizeof(BinaryHeader) || reinterpret_cast<uintptr_t>(file.data()) % alignof(BinaryHeader) != 0) return false;
+
+            Header = reinterpret_cast<const BinaryHeader*>(file.data());
+            if (std::memcmp(Header->Magic, BinaryHeader::MagicValue, sizeof(Header->Magic)) != 0) return false;
+            if (Header->Version != BinaryHeader::CurrentVersion || Header->HeaderSize != sizeof(BinaryHeader)) return false;
+            if (Header->ByteOrder != BinaryHeader::ByteOrderMark || Header->Layout != BinaryHeader::LayoutValue) return false;
+
+            uint64_t tables = uint64_t(Header->NodeCount) * sizeof(BinaryNode) + uint64_t(Header->AttributeCount) * sizeof(BinaryAttribute)
+                + uint64_t(Header->NameCount) * sizeof(BinaryString);
+            if (file.size() - sizeof(BinaryHeader) != tables + Header->StringBytes) return false;
+
+            string_view payload = file.substr(sizeof(BinaryHeader));
+            if (HashBytes(payload.data(), payload.size()) != Header->PayloadHash) return false;
+
+            if (source != nullptr && (source->size() != Header->SourceSize || HashBytes(source->data(), source->size()) != Header->SourceHash)) return false;
+
+            const char* at = payload.data();
+            Nodes = reinterpret_cast<const BinaryNode*>(at);
+            at += Header->NodeCount * sizeof(BinaryNode);
+            Attributes = reinterpret_cast<const BinaryAttribute*>(at);
+            at += Header->AttributeCount * sizeof(BinaryAttribute);
+            Names = reinterpret_cast<const BinaryString*>(at);
+            at += Header->NameCount * sizeof(BinaryString);
+            Strings = string_view(at, Header->StringBytes);
+
+            return Check();
+        }
+
+        string_view String(const BinaryString& s) const
+        {
+            return Strings.substr(s.Offset, s.Length);
+        }
+
+    protected:
+        // every index and offset is range checked once, so loading can trust them afterwards
+        bool Check() const
+        {
+            auto inStrings = [&](const BinaryString& s) { return s.Offset <= Strings.size() && s.Length <= Strings.size() - s.Offset; };
+            auto nodeLink = [&](uint32_t link, uint32_t from) { return link == NodeArena::None || (link > from && link < Header->NodeCount); };
+
+            for (uint32_t i = 0; i < Header->NameCount; i++)
+            {
+                if (!inStrings(Names[i])) return false;
             }
+            for (uint32_t i = 0; i < Header->AttributeCount; i++)
+            {
+                if (Attributes[i].Key >= Header->NameCount || !inStrings(Attributes[i].Value)) return false;
+            }
+            for (uint32_t i = 0; i < Header->NodeCount; i++)
+            {
+                const BinaryNode& node = Nodes[i];
+                if (node.Name >= Header->NameCount || node.ElementType > static_cast<uint32_t>(Element::Type::Complex) || !inStrings(node.Value)) return false;
+                if (!nodeLink(node.FirstChild, i) || !nodeLink(node.NextSibling, i)) return false;
+                if (node.FirstAttribute > Header->AttributeCount || node.AttributeCount > Header->AttributeCount - node.FirstAttribute) return false;
+            }
+            return true;
         }
-    }
-    return Element::Invalid;
-}
+    };
 
-std::string nxml::Element::ToString()
-{
-    if (ElementType == Type::Invalid)
+    /// <summary>
+    /// Flattens a Document into the snapshot tables
+    /// </summary>
+    struct BinaryWriter
     {
-        return std::string();
-    }
+        vector<BinaryNode>              Nodes;
+        vector<BinaryAttribute>         Attributes;
+        vector<BinaryString>            Names;
+        string                          Strings;
+        unordered_map<string, uint32_t> NameIndex;
 
-    stringstream s;
-    s << '<' << ElementName;
-    for (Attribute& attr : Attributes)
-    {
-        s << ' ' << attr.Key << '=' << '"' << attr.SerializedValue << '"';
-    }
-    s << '>'; 
-    if (ElementType == Type::Complex)
-    {
-        for (auto& inner : InnerElements)
+        BinaryString AddString(const string& value)
         {
-            s << inner.ToString();
+            BinaryString s{ Strings.size(), value.size() };
+            Strings.append(value);
+            return s;
         }
 
-        s << "</" << ElementName << '>';
-        return s.str();
-    }
+        uint32_t AddName(const string& name)
+        {
+            auto found = NameIndex.find(name);
+            if (found != NameIndex.end()) return found->second;
 
-    s << '<' << ElementName;
-    for (Attribute& attr : Attributes)
-    {
-        s << ' ' << attr.Key << '=' << '"' << attr.SerializedValue << '"';
-    }
-    s << '>' << InnerValue << "</" << ElementName << '>';
-    return s.str();
+            uint32_t index = static_cast<uint32_t>(Names.size());
+            Names.push_back(AddString(name));
+            NameIndex.emplace(name, index);
+            return index;
+        }
 
-}
+        uint32_t AddElement(const Element& e)
+        {
+            uint32_t index = static_cast<uint32_t>(Nodes.size());
+            Nodes.push_back(BinaryNode{ AddName(e.ElementName), static_cast<uint32_t>(e.ElementType), NodeArena::None, NodeArena::None,
+                static_cast<uint32_t>(Attributes.size()), static_cast<uint32_t>(e.Attributes.size()), AddString(e.InnerValue) });
 
-nxml::Element& nxml::Document::operator[](const char* key)
-{
-    for (Element& e : RootElements)
+            for (const Attribute& attr : e.Attributes)
+            {
+                Attributes.push_back(BinaryAttribute{ AddName(attr.Key), 0, AddString(attr.SerializedValue) });
+            }
+
+            // Nodes may grow while children are added, so links are written by index
+            uint32_t previous = NodeArena::None;
+            for (const Element& inner : e.InnerElements)
+            {
+                uint32_t child = AddElement(inner);
+                if (previous == NodeArena::None) Nodes[index].FirstChild = child;
+                else Nodes[previous].NextSibling = child;
+                previous = child;
+            }
+            return index;
+        }
+
+        template <typename T>
+        static void Append(string& out, const vector<T>& items)
+        {
+            out.append(reinterpret_cast<const char*>(items.data()), items.size() * sizeof(T));
+        }
+    };
+
+    static Element LoadBinaryElement(const BinarySnapshot& snapshot, uint32_t index)
     {
-        if (e.ElementName == std::string(key)) return e;
+        const BinaryNode& node = snapshot.Nodes[index];
+        Element e(static_cast<Element::Type>(node.ElementType));
+        e.ElementName = string(snapshot.String(snapshot.Names[node.Name]));
+        e.InnerValue = string(snapshot.String(node.Value));
+
+        e.Attributes.reserve(node.AttributeCount);
+        for (uint32_t i = node.FirstAttribute; i < node.FirstAttribute + node.AttributeCount; i++)
+        {
+            Attribute attr;
+            attr.Key = string(snapshot.String(snapshot.Names[snapshot.Attributes[i].Key]));
+            attr.SerializedValue = string(snapshot.String(snapshot.Attributes[i].Value));
+            e.Attributes.push_back(std::move(attr));
+        }
+
+        for (uint32_t child = node.FirstChild; child != NodeArena::None; child = snapshot.Nodes[child].NextSibling)
+        {
+            e.InnerElements.emplace_back(LoadBinaryElement(snapshot, child));
+        }
+        return e;
     }
-    return Element::Invalid;
 }
 
-std::string nxml::Document::ToString()
+bool nxml::Document::SaveBinary(const char* path, std::string_view source) const
 {
-    stringstream s;
-    s << Decl.ToString();
-    for (auto& e: RootElements)
+    BinaryWriter writer;
+    uint32_t previous = NodeArena::None;
+    for (const Element& e : RootElements)
     {
-        s << e.ToString();
+        uint32_t root = writer.AddElement(e);
+        if (previous != NodeArena::None) writer.Nodes[previous].NextSibling = root;
+        previous = root;
     }
 
-    
+    string payload;
+    payload.reserve(writer.Nodes.size() * sizeof(BinaryNode) + writer.Attributes.size() * sizeof(BinaryAttribute)
+        + writer.Names.size() * sizeof(BinaryString) + writer.Strings.size());
+    BinaryWriter::Append(payload, writer.Nodes);
+    BinaryWriter::Append(payload, writer.Attributes);
+    BinaryWriter::Append(payload, writer.Names);
+    payload.append(writer.Strings);
+
+    BinaryHeader header = {};
+    std::memcpy(header.Magic, BinaryHeader::MagicValue, sizeof(header.Magic));
+    header.Version = BinaryHeader::CurrentVersion;
+    header.HeaderSize = sizeof(BinaryHeader);
+    header.ByteOrder = BinaryHeader::ByteOrderMark;
+    header.Layout = BinaryHeader::LayoutValue;
+    header.SourceSize = source.size();
+    header.SourceHash = HashBytes(source.data(), source.size());
+    header.NodeCount = static_cast<uint32_t>(writer.Nodes.size());
+    header.AttributeCount = static_cast<uint32_t>(writer.Attributes.size());
+    header.NameCount = static_cast<uint32_t>(writer.Names.size());
+    header.StringBytes = writer.Strings.size();
+    header.PayloadHash = HashBytes(payload.data(), payload.size());
+
+    // written beside the target and renamed over it, documents still mapping the old snapshot keep their copy
+    string temporary = string(path) + ".tmp";
+    {
+        std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(payload.data(), payload.size());
+        if (!out) return false;
+    }
 
-    string docStringRaw = s.str();
-    utils::CleanWhiteSpace(docStringRaw);
-    return docStringRaw;
+#ifdef _WIN32
+    std::remove(path);
+#endif
+    return std::rename(temporary.c_str(), path) == 0;
 }
 
-void nxml::Parser::ClearCurrentElement()
-{        
-    // CreateElement;
-    p_ElementNameStream.str(std::string());
-    p_ElementValueStream.str(std::string());
+bool nxml::Document::LoadBinary(const char* path)
+{
+    return LoadSnapshot(path, nullptr);
 }
 
-void nxml::Parser::ClearCurrentAttribute()
+bool nxml::Document::LoadBinary(const char* path, std::string_view source)
 {
-    // Clear streams
-    p_AttributeNameStream.str(std::string());
-    p_AttributeValueStream.str(std::string());
+    return LoadSnapshot(path, &source);
 }
 
-void nxml::Parser::CreateElement(Element::Type elementType)
+bool nxml::Document::LoadSnapshot(const char* path, const std::string_view* source)
 {
-    string elementName = p_ElementNameStream.str();
+    MappedFile file(path);
+    BinarySnapshot snapshot;
+    if (!file.IsValid() || !snapshot.Open(file.View(), source)) return false;
 
-    p_ElementStack.emplace(Element(elementType));
-    p_ElementStack.top().ElementName = elementName;
+    RootElements.clear();
+    if (snapshot.Header->NodeCount == 0) return true;
 
-    while (!p_AttributeStack.empty())
+    for (uint32_t root = 0; root != NodeArena::None; root = snapshot.Nodes[root].NextSibling)
     {
-        auto& e = p_ElementStack.top();
-        e.Attributes.push_back(p_AttributeStack.top());
-        p_AttributeStack.pop();
+        RootElements.emplace_back(LoadBinaryElement(snapshot, root));
     }
+    return true;
 }
 
-void nxml::Parser::CloseElement()
+bool nxml::DocumentView::LoadBinary(const char* path)
 {
-    Element e = p_ElementStack.top();
-    p_ElementStack.pop();
+    return LoadSnapshot(path, nullptr);
+}
 
-    if (p_ElementStack.empty())
+bool nxml::DocumentView::LoadBinary(const char* path, std::string_view source)
+{
+    return LoadSnapshot(path, &source);
+}
+
+bool nxml::DocumentView::LoadSnapshot(const char* path, const std::string_view* source)
+{
+    auto file = std::make_shared<const MappedFile>(path);
+    BinarySnapshot snapshot;
+    if (!file->IsValid() || !snapshot.Open(file->View(), source)) return false;
+
+    bool cacheValues = p_Nodes->CacheValues;
+    p_Nodes = std::make_unique<NodeArena>(p_Nodes->Names);
+    p_Nodes->CacheValues = cacheValues;
+    p_SourceOwner = file;
+    Source = snapshot.Strings;
+
+    NodeArena& nodes = *p_Nodes;
+    vector<Atom> atoms(snapshot.Header->NameCount);
+    for (uint32_t i = 0; i < snapshot.Header->NameCount; i++)
     {
-        p_ElementStack.push(e);
-        return;
+        atoms[i] = nodes.Intern(snapshot.String(snapshot.Names[i]));
     }
 
-    Element& parent = p_ElementStack.top();
+    // the tables already are pre-order arrays, only atoms, string views and the reverse links need filling in
+    nodes.Attributes.resize(snapshot.Header->AttributeCount);
+    for (uint32_t i = 0; i < snapshot.Header->AttributeCount; i++)
+    {
+        const BinaryAttribute& attr = snapshot.Attributes[i];
+        nodes.Attributes[i].Key = atoms[attr.Key];
+        nodes.Attributes[i].SerializedValue = snapshot.String(attr.Value);
+    }
 
-    parent.InnerElements.emplace_back(e);
-}
+    nodes.Nodes.resize(snapshot.Header->NodeCount);
+    for (uint32_t i = 0; i < snapshot.Header->NodeCount; i++)
+    {
+        const BinaryNode& binary = snapshot.Nodes[i];
+        NodeArena::Node& node = nodes.Nodes[i];
+        node.ElementType = static_cast<Element::Type>(binary.ElementType);
+        node.Name = atoms[binary.Name];
+        node.InnerValue = snapshot.String(binary.Value);
+        node.FirstChild = binary.FirstChild;
+        node.NextSibling = binary.NextSibling;
 
-void nxml::Parser::AssignElementValue()
-{
-    auto& e = p_ElementStack.top();
-    e.InnerValue = p_ElementValueStream.str();
-}
+        if (binary.AttributeCount != 0)
+        {
+            node.FirstAttribute = binary.FirstAttribute;
+            node.LastAttribute = binary.FirstAttribute + binary.AttributeCount - 1;
+            for (uint32_t a = node.FirstAttribute; a < node.LastAttribute; a++) nodes.Attributes[a].Next = a + 1;
+        }
 
-void nxml::Parser::CreateAttribute()
-{
-    Attribute attr;
-    attr.Key = p_AttributeNameStream.str();
-    attr.SerializedValue = p_AttributeValueStream.str();
+        for (uint32_t child = binary.FirstChild; child != NodeArena::None; child = snapshot.Nodes[child].NextSibling)
+        {
+            nodes.Nodes[child].Parent = i;
+            node.LastChild = child;
+        }
+    }
 
-    p_AttributeStack.push(attr);
+    if (!nodes.Nodes.empty())
+    {
+        nodes.FirstRoot = 0;
+        for (uint32_t root = 0; root != NodeArena::None; root = nodes.Nodes[root].NextSibling) nodes.LastRoot = root;
+    }
+    return true;
 }
 
-void nxml::Parser::LogCurrentElementName()
+nxml::DocumentView nxml::ParseFileCached(const char* path, const char* cachePath)
 {
-    // create Element object
-    cout << "\n" << "Current Element Name : " << p_ElementNameStream.str() << endl;
-    // Clear Element streams
-    cout << "Current Element Value : " << p_ElementValueStream.str() << "\n" << endl;
-}
+    auto file = std::make_shared<const MappedFile>(path);
+    // without readable source xml there is nothing to check the snapshot against, so it is not trusted either
+    if (!file->IsValid()) return DocumentView();
 
-void nxml::Parser::LogCurrentAttributes()
-{
-    // create attribute object
-    cout << "\n" << "Current Attribute Name : " << p_AttributeNameStream.str() << endl;
-    cout << "Current Attribute Value : " << p_AttributeValueStream.str() << "\n" << endl;
-    ClearCurrentAttribute();
+    DocumentView cached;
+    if (cached.LoadBinary(cachePath, file->View())) return cached;
+
+    DocumentView doc = ThreadParser().GetViewFromString(file->View(), file);
+    doc.ToDocument().SaveBinary(cachePath, file->View());
+    return doc;
 }
 
 
-std::string nxml::Parser::GetModeName(nxml::Parser::Mode& mode)
+std::string nxml::BatchStats::ToString() const
 {
-    switch(mode)
-    {
-        case Mode::Declaration:
-        return "Declaration";
-        case Mode::WaitForElementOpen:
-        return "WaitForElementOpen";
-        case Mode::ElementOpen:
-        return "ElementOpen";
-        case Mode::ElementClose:
-        return "ElementClose";
-        case Mode::WaitForAttribute:
-        return "WaitForAttribute";
-        case Mode::ElementAttributeName:
-        return "ElementAttributeName";
-        case Mode::ElementAttributeValue:
-        return "ElementAttributeValue";
-        case Mode::GetInnerElementType:
-        return "GetInnerElementType";
-        case Mode::ElementValue:
-        return "ElementValue";
-        default:
-        return "Unknown Mode Type";
-    }
+    std::ostringstream out;
+    double megabytes = static_cast<double>(Bytes) / (1024.0 * 1024.0);
+    out << Files << " files (" << Failed << " failed), " << megabytes << " MB in " << Seconds * 1000.0 << " ms";
+    if (Seconds > 0.0) out << ", " << megabytes / Seconds << " MB/s";
+    out << "\n    read : " << ReadSeconds * 1000.0 << " ms, parse : " << ParseSeconds * 1000.0 << " ms summed over files";
+    if (!SlowestFile.empty()) out << "\n    slowest : " << SlowestFile << " " << SlowestFileSeconds * 1000.0 << " ms";
+    return out.str();
 }
 
-void nxml::Parser::SwitchMode(nxml::Parser::Mode newMode, char current)
+nxml::BatchStats nxml::ParseFiles(const std::vector<std::string>& paths, const BatchConsumer& consumer, const BatchOptions& options)
 {
-    // cout << "        Switch Mode : Current Mode : " << GetModeName(p_Mode) << ", New Mode : " << GetModeName(newMode) << ", From Character : '" << current << "'\n";
-    p_Mode = newMode;
-}
+    ThreadPool& pool = options.Pool != nullptr ? *options.Pool : ThreadPool::Shared();
+    auto start = chrono::steady_clock::now();
 
-void nxml::Parser::ProcessCharacter(std::string& xmlString, int charIndex)
-{
-    uint32_t nextIndex = static_cast<uint32_t>(charIndex + 1);
+    BatchStats stats;
+    std::mutex mutex;
+    std::condition_variable finished;
+    uint64_t inFlightBytes = 0;
+    size_t inFlightFiles = 0;
+    std::exception_ptr failure;
+    // parsed files waiting for the consumer, with the bytes they hold of the in-flight budget
+    std::deque<std::pair<BatchResult, uint64_t>> parsed;
 
-    if (nextIndex == xmlString.size())
+    // consumers run here on the calling thread with no lock held, so one that parses on the same pool cannot block a worker
+    // on a lock this thread holds. A file stays in flight until its consumer returned
+    auto consume = [&](std::unique_lock<std::mutex>& lock)
     {
-        return;
-    }
-    char c  = xmlString.at(charIndex);
-    char nc = xmlString.at(nextIndex);
+        while (!parsed.empty())
+        {
+            std::pair<BatchResult, uint64_t> next = std::move(parsed.front());
+            parsed.pop_front();
 
-    switch(p_Mode)
-    {
-        case Mode::Declaration:
-            if(c == '?' && nc == '>') SwitchMode(Mode::WaitForElementOpen, c);
-            break;
-        case Mode::WaitForElementOpen:
-            if(c != '<') return;
-            SwitchMode(Mode::ElementOpen, c);
-            break;
-        case Mode::ElementOpen:
-            if(c == '/')
-            {
-                LogCurrentElementName();
-                SwitchMode(Mode::ElementClose, c);
-                return;
-            }
-            if(c == '>')
-            {
-                SwitchMode(Mode::GetInnerElementType, c);
-                return;
-            }
-            if(c == ' ')
-            {
-                SwitchMode(Mode::WaitForAttribute, c);
-                return;
-            }
-            p_ElementNameStream << c;
-            break;
-        case Mode::WaitForAttribute:
-            if(c == ' ') return;
-            if(c == '>') 
-            {
-                SwitchMode(Mode::GetInnerElementType, c);
-                return;
-            }
-            if(c == '/')
-            {
-                SwitchMode(Mode::ElementClose, c);
-                return;
-            }
-            SwitchMode(Mode::ElementAttributeName, c);
-            p_AttributeNameStream << c;
-            break;    
-        case Mode::ElementAttributeName:
-            if(c == '=') 
-            {
-                SwitchMode(Mode::ElementAttributeValue, c);
-                return;
-            }
-            if(c == '"')
+            if (!failure)
             {
-                SwitchMode(Mode::ElementAttributeValue, c);
-                return;
-            } 
-            // push char into attribute name stream
-            p_AttributeNameStream << c;
-            break;
-        case Mode::ElementAttributeValue:
-            if(c == '=') return;
-            if(c == '"') return;
-            if(c == ' ')
-            {
-                CreateAttribute();
-                LogCurrentAttributes();
-                SwitchMode(Mode::WaitForAttribute, c);
-                return;
+                lock.unlock();
+                std::exception_ptr consumerFailure;
+                try
+                {
+                    consumer(next.first);
+                }
+                catch (...)
+                {
+                    consumerFailure = std::current_exception();
+                }
+                lock.lock();
+                if (consumerFailure && !failure) failure = consumerFailure;
             }
-            if(c == '>')
+
+            inFlightBytes -= next.second;
+            inFlightFiles--;
+        }
+    };
+
+    // called from a task on the same pool, the files may be queued behind this very thread, so it runs them while it waits
+    bool help = pool.IsWorkerThread();
+    auto wait = [&](std::unique_lock<std::mutex>& lock, auto ready)
+    {
+        for (;;)
+        {
+            consume(lock);
+            if (ready()) return;
+
+            if (help)
             {
-                CreateAttribute();
-                LogCurrentAttributes();
-                SwitchMode(Mode::GetInnerElementType, c);
-                return;
+                lock.unlock();
+                bool ran = pool.RunPendingTask();
+                lock.lock();
+                if (ran) continue;
             }
-            // push char into attribute value stream;
-            p_AttributeValueStream << c;
-            break;
-        case Mode::ElementClose:
-            LogCurrentElementName();
-            CloseElement();
-            ClearCurrentElement();
-            SwitchMode(Mode::WaitForElementOpen, c); 
-            break;
-        case Mode::GetInnerElementType:
-            if(c == ' ') return;
-            if(c == '<')
+            // nothing queued, the outstanding files are running on other threads and will notify
+            finished.wait(lock, [&]() { return !parsed.empty() || ready(); });
+        }
+    };
+
+    for (const string& path : paths)
+    {
+        std::error_code error;
+        uint64_t size = std::filesystem::file_size(path, error);
+        if (error) size = 0;
+
+        {
+            // wait for room, a file larger than the budget is let through once nothing else is running
+            std::unique_lock<std::mutex> lock(mutex);
+            wait(lock, [&]() { return failure || inFlightFiles == 0 || inFlightBytes + size <= options.MaxInFlightBytes; });
+            if (failure) break;
+
+            inFlightBytes += size;
+            inFlightFiles++;
+        }
+
+        pool.Submit([&, path, size]()
+        {
+            BatchResult result;
+            result.Path = path;
+
+            auto readStart = chrono::steady_clock::now();
+            MappedFile file(path.c_str());
+            auto parseStart = chrono::steady_clock::now();
+            result.ReadSeconds = chrono::duration<double>(parseStart - readStart).count();
+
+            if (!file.IsValid())
             {
-                CreateElement(Element::Type::Complex);
-                ClearCurrentElement();
-                SwitchMode(Mode::ElementOpen, c);
-                return;
+                result.Error = "could not read file";
             }
-            if(iswalnum(c))
+            else
             {
-                CreateElement(Element::Type::Value);
-                p_ElementValueStream << c;
-                SwitchMode(Mode::ElementValue, c);
-                return;
+                result.Bytes = file.Size();
+                bool decoded = ParseMappedFile(file, result.Doc);
+                result.ParseSeconds = chrono::duration<double>(chrono::steady_clock::now() - parseStart).count();
+                if (!decoded) result.Error = "compressed data is damaged or truncated";
+                else if (result.Doc.RootElements.empty()) result.Error = "no root element";
             }
 
-            break;
-        case Mode::ElementValue:
-            if(c == '<')
+            std::lock_guard<std::mutex> lock(mutex);
+            stats.Files++;
+            stats.Bytes += result.Bytes;
+            stats.ReadSeconds += result.ReadSeconds;
+            stats.ParseSeconds += result.ParseSeconds;
+            if (!result.Ok()) stats.Failed++;
+            if (result.ReadSeconds + result.ParseSeconds > stats.SlowestFileSeconds)
             {
-                AssignElementValue();
-                SwitchMode(Mode::ElementClose, c);
-                return;
+                stats.SlowestFileSeconds = result.ReadSeconds + result.ParseSeconds;
+                stats.SlowestFile = path;
             }
-            p_ElementValueStream << c;
-            break;
-        default:
-            break;
+
+            parsed.emplace_back(std::move(result), size);
+            finished.notify_all();
+        });
     }
+
+    std::unique_lock<std::mutex> lock(mutex);
+    wait(lock, [&]() { return inFlightFiles == 0; });
+    stats.Seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    if (failure) std::rethrow_exception(failure);
+    return stats;
 }
 
-nxml::Document nxml::Parser::GetFromString(std::string& xml)
+nxml::BatchStats nxml::ParseDirectory(const char* directory, const BatchConsumer& consumer, const BatchOptions& options)
 {
-    nxml::Document doc;
+    std::vector<std::string> paths;
+    std::error_code error;
+
+    auto collect = [&](const std::filesystem::directory_entry& entry)
+    {
+        if (entry.is_regular_file(error) && (options.Extension.empty() || entry.path().extension() == options.Extension))
+        {
+            paths.push_back(entry.path().string());
+        }
+    };
 
-    for(int i = 0; i < xml.size(); i++)
+    if (options.Recursive)
     {
-        ProcessCharacter(xml, i);
+        for (const auto& entry : std::filesystem::recursive_directory_iterator(directory, error)) collect(entry);
     }
-    
-    while(!p_ElementStack.empty())
+    else
     {
-        doc.RootElements.emplace_back(p_ElementStack.top());
-        p_ElementStack.pop();
+        for (const auto& entry : std::filesystem::directory_iterator(directory, error)) collect(entry);
     }
 
-    return doc;
-}
-
-void nxml::utils::CleanWhiteSpace(std::string& input)
-{
-    static std::regex e("[ \t]+");   // matches trailing whitespace
-    input.erase(std::remove(input.begin(), input.end(), '\r'), input.end());
-    input.erase(std::remove(input.begin(), input.end(), '\n'), input.cend());
-    input.erase(std::remove(input.begin(), input.end(), '\t'), input.end());
-
-    input = std::regex_replace(input, e, " $2"); // replace all trailing space wioth single space.
-    
-}
-
-std::string nxml::utils::LoadFileAsString(const char* path) {
-    std::fstream file;
-    file.open(path);
-
-    std::string str((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
-
-    return str;
-}
-
-void nxml::utils::SaveStringToFile(const char* path, std::string & str) {
-    std::ofstream out(path);
-    out << str;
-    out.close();
-}
+    // largest first, so a big file found last does not leave the other workers idle at the end
+    std::vector<std::pair<uint64_t, std::string>> sized;
+    sized.reserve(paths.size());
+    for (std::string& path : paths) sized.emplace_back(std::filesystem::file_size(path, error), std::move(path));
+    std::sort(sized.begin(), sized.end(), [](const auto& a, const auto& b) { return a.first > b.first; });
 
-nxml::Document nxml::ParseString(std::string& input)
-{
-    nxml::Parser parser;
-    return parser.GetFromString(input);
+    paths.clear();
+    for (auto& entry : sized) paths.push_back(std::move(entry.second));
+    return ParseFiles(paths, consumer, options);
 }
 
 #endif
\ No newline at end of file
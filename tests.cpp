@@ -0,0 +1,366 @@
+#define NXML_IMPL
+#include "nxml.hpp"
+#include <fstream>
+#include <iostream>
+
+using namespace std;
+
+// Regression checks run by ctest, each one prints what differed and counts as a failure
+static int s_Failures = 0;
+
+#define CHECK(exp, what) do { if (!(exp)) { s_Failures++; cerr << __FILE__ << ":" << __LINE__ << ": " << what << "\n"; } } while (0)
+
+static string SamplePath = "sample.xml";
+
+// Feed must give the same tree whatever the chunk boundaries, splits inside a tag, an attribute value and "?>" included,
+// and so must a projected parse, whose skipped subtrees are resumed across chunks
+static void TestChunkedFeed()
+{
+    string xml = nxml::utils::LoadFileAsString(SamplePath.c_str());
+    CHECK(!xml.empty(), "could not read " << SamplePath);
+    string expected = nxml::ParseString(xml).ToString();
+
+    nxml::Parser parser;
+    for (size_t chunk = 1; chunk <= xml.size(); chunk++)
+    {
+        nxml::DocumentBuilder builder;
+        parser.Begin(builder);
+        for (size_t i = 0; i < xml.size(); i += chunk)
+        {
+            parser.Feed(xml.data() + i, std::min(chunk, xml.size() - i));
+        }
+        parser.Finish();
+
+        CHECK(builder.Doc.ToString() == expected, "chunked feed differs with " << chunk << " byte chunks");
+    }
+
+    // skipped subtrees resume across chunk boundaries, with '>' and "/>" inside quotes that must not end a tag early
+    string projectedXml = xml;
+    projectedXml.insert(projectedXml.rfind("</catalog>"),
+        "<book id=\"bk900\"><extra note=\"a > b\" other='c/>d'><deep/><deeper k=\">\"/></extra><price>1.5</price></book>\n"
+        "<misc a='>'><x/><y b=\"</misc>\"/></misc>\n");
+    nxml::Projection projection{ "catalog/book/@id", "catalog/book/price" };
+    string projectedExpected = nxml::ParseProjected(projectedXml, projection).ToString();
+    CHECK(projectedExpected.find("bk900") != string::npos && projectedExpected.find("misc") == string::npos, "projected parse is wrong");
+
+    parser.SetProjection(&projection);
+    for (size_t chunk = 1; chunk <= projectedXml.size(); chunk++)
+    {
+        nxml::DocumentBuilder builder;
+        parser.Begin(builder);
+        for (size_t i = 0; i < projectedXml.size(); i += chunk)
+        {
+            parser.Feed(projectedXml.data() + i, std::min(chunk, projectedXml.size() - i));
+        }
+        parser.Finish();
+
+        CHECK(builder.Doc.ToString() == projectedExpected, "chunked projected feed differs with " << chunk << " byte chunks");
+    }
+    parser.SetProjection(nullptr);
+}
+
+// wide enough to be split into several chunks, with the tricky bits (attributes, references, nesting) in every child
+static string WideDocument(size_t children)
+{
+    string xml = "<?xml version=\"1.0\"?>\n<catalog kind=\"test\">\n";
+    for (size_t i = 0; i < children; i++)
+    {
+        xml += "  <book id=\"bk" + to_string(i) + "\" note='a &amp; b'><title>Title " + to_string(i) + "</title>"
+            "<price>" + to_string(i % 100) + ".95</price><tags><tag>x</tag><tag/></tags></book>\n";
+    }
+    xml += "</catalog>\n";
+    return xml;
+}
+
+// ParseParallel must give exactly the tree ParseString does, also when called from a task of the pool it uses
+static void TestParallelIdentity()
+{
+    string xml = WideDocument(20000);
+    string serial = nxml::ParseString(xml).ToString();
+
+    nxml::ThreadPool pool(4);
+    CHECK(nxml::ParseParallel(xml, &pool).ToString() == serial, "ParseParallel differs from ParseString");
+
+    // every worker waits on chunks queued behind it, which only finishes when waiting workers help
+    nxml::ThreadPool small(2);
+    vector<future<void>> nested;
+    vector<string> results(small.ThreadCount() * 2);
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        nested.push_back(small.Submit([&, i]() { results[i] = nxml::ParseParallel(xml, &small).ToString(); }));
+    }
+    small.WaitAll(nested);
+    for (const string& result : results)
+    {
+        CHECK(result == serial, "ParseParallel from inside a pool task differs from ParseString");
+    }
+}
+
+// a batch started from a task on a one-thread pool has only the calling worker to parse its files
+static void TestNestedParseFiles()
+{
+    vector<string> paths(8, SamplePath);
+    nxml::ThreadPool pool(1);
+    nxml::BatchOptions options;
+    options.Pool = &pool;
+
+    size_t consumed = 0;
+    nxml::BatchStats stats;
+    pool.Submit([&]()
+    {
+        stats = nxml::ParseFiles(paths, [&](nxml::BatchResult& result) { if (result.Ok()) consumed++; }, options);
+    }).get();
+
+    CHECK(stats.Files == paths.size() && stats.Failed == 0, "ParseFiles from a pool task parsed " << stats.Files << " files, " << stats.Failed << " failed");
+    CHECK(consumed == paths.size(), "ParseFiles from a pool task consumed " << consumed << " results");
+
+    // consumers that parse on the same pool again, while other files of the batch are still queued
+    string wide = WideDocument(2000);
+    string serial = nxml::ParseString(wide).ToString();
+    nxml::ThreadPool shared(2);
+    options.Pool = &shared;
+    size_t reentered = 0;
+    shared.Submit([&]()
+    {
+        nxml::ParseFiles(paths, [&](nxml::BatchResult&)
+        {
+            bool same = nxml::ParseParallel(wide, &shared).ToString() == serial;
+            nxml::BatchStats inner = nxml::ParseFiles({ SamplePath, SamplePath }, [](nxml::BatchResult&) {}, options);
+            if (same && inner.Files == 2 && inner.Failed == 0) reentered++;
+        }, options);
+    }).get();
+    CHECK(reentered == paths.size(), "consumers parsing on the batch's own pool completed " << reentered << " of " << paths.size());
+}
+
+static string TempPath(const char* name)
+{
+    return (std::filesystem::temp_directory_path() / name).string();
+}
+
+#if NXML_ZLIB
+// a gzip file cut in half must fail to load rather than parse into the first half of the document
+static void TestTruncatedGzip()
+{
+    string xml = WideDocument(20000);
+    string path = TempPath("nxml-tests-truncated.xml.gz");
+    CHECK(nxml::utils::SaveStringToFile(path.c_str(), xml), "could not write " << path);
+
+    string whole;
+    CHECK(nxml::utils::LoadFileAsString(path.c_str(), whole) && whole == xml, "gzip round trip differs");
+    CHECK(nxml::ParseFile(path.c_str()).RootElements.size() == 1, "ParseFile of the whole gzip file has no root");
+
+    std::filesystem::resize_file(path, std::filesystem::file_size(path) / 2);
+
+    string loaded = "stale";
+    CHECK(!nxml::utils::LoadFileAsString(path.c_str(), loaded) && loaded.empty(), "LoadFileAsString accepted a truncated gzip file");
+    CHECK(nxml::ParseFile(path.c_str()).RootElements.empty(), "ParseFile returned part of a truncated gzip file");
+
+    nxml::BatchStats stats = nxml::ParseFiles({ path }, [&](nxml::BatchResult& result)
+    {
+        CHECK(!result.Ok() && result.Doc.RootElements.empty(), "ParseFiles reported a truncated gzip file as parsed");
+    });
+    CHECK(stats.Failed == 1, "ParseFiles counted " << stats.Failed << " failed files for a truncated gzip file");
+
+    std::filesystem::remove(path);
+}
+#endif
+
+static void WriteText(const string& path, const string& text)
+{
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out << text;
+}
+
+// snapshots round trip, and go stale when their source changes, empties or disappears
+static void TestBinarySnapshots()
+{
+    string xml = nxml::utils::LoadFileAsString(SamplePath.c_str());
+    string source = TempPath("nxml-tests-snapshot.xml");
+    string cache = TempPath("nxml-tests-snapshot.bin");
+    std::filesystem::remove(cache);
+
+    nxml::Document doc = nxml::ParseString(xml);
+    CHECK(doc.SaveBinary(cache.c_str(), xml), "SaveBinary failed");
+    nxml::Document loaded;
+    CHECK(loaded.LoadBinary(cache.c_str(), xml) && loaded.ToString() == doc.ToString(), "Document snapshot round trip differs");
+    CHECK(!loaded.LoadBinary(cache.c_str(), "<other/>"), "snapshot accepted for other xml");
+    CHECK(!loaded.LoadBinary(cache.c_str(), string_view()), "snapshot accepted for an empty source");
+    CHECK(loaded.LoadBinary(cache.c_str()), "snapshot without a source check rejected");
+
+    WriteText(source, xml);
+    std::filesystem::remove(cache);
+    string expected = nxml::ParseView(string_view(xml)).ToString();
+    CHECK(nxml::ParseFileCached(source.c_str(), cache.c_str()).ToString() == expected, "ParseFileCached differs on the first parse");
+    CHECK(nxml::ParseFileCached(source.c_str(), cache.c_str()).ToString() == expected, "ParseFileCached differs when loaded from the snapshot");
+
+    WriteText(source, "<changed/>");
+    CHECK(nxml::ParseFileCached(source.c_str(), cache.c_str()).RootElements().size() == 1
+        && nxml::ParseFileCached(source.c_str(), cache.c_str())["changed"].IsValid(), "ParseFileCached used a stale snapshot");
+
+    WriteText(source, "");
+    CHECK(nxml::ParseFileCached(source.c_str(), cache.c_str()).RootElements().size() == 0, "ParseFileCached used a snapshot of a source that is now empty");
+
+    WriteText(source, "<again/>");
+    nxml::ParseFileCached(source.c_str(), cache.c_str());
+    std::filesystem::remove(source);
+    CHECK(nxml::ParseFileCached(source.c_str(), cache.c_str()).RootElements().size() == 0, "ParseFileCached used a snapshot of a missing source");
+
+    std::filesystem::remove(cache);
+}
+
+static string ReplaceOnce(string text, string_view from, string_view to)
+{
+    size_t at = text.find(from);
+    if (at != string::npos) text.replace(at, from.size(), to);
+    return text;
+}
+
+// an edit regenerates only the changed element and its ancestors' tags, everything between the tags stays as it was
+static void TestOriginalWhiteSpace()
+{
+    string xml = "<?xml version=\"1.0\"?>\n<r x=\"a>b\">\n  <a>1</a>\n  between\n  <b>2</b>\n  <c/>\n  trail\n</r>\n";
+    nxml::DocumentView view = nxml::ParseView(string_view(xml));
+    CHECK(view.ToSourceString() == xml, "unedited ToSourceString differs from the source");
+
+    view["r"]["b"].SetInnerValue("3");
+    string expected = ReplaceOnce(ReplaceOnce(xml, "<b>2</b>", "<b>3</b>"), "x=\"a>b\"", "x=\"a&gt;b\"");
+    string written = view.ToSourceString();
+    CHECK(written == expected, "edited ToSourceString gave '" << written << "'");
+}
+
+// a '+' is only allowed in front of the digits, a value that does not decode leaves the target alone, and dates must exist
+static void TestValueDecoding()
+{
+    const nxml::AttributeView badInt{ "k", "+-5" }, badDouble{ "k", "+-1.5" }, plusInt{ "k", " +7 " }, plusDouble{ "k", "+.5" };
+    CHECK(badInt.AsInt(99) == 99, "+-5 decoded as an integer");
+    CHECK(badDouble.AsDouble(99.0) == 99.0, "+-1.5 decoded as a double");
+    CHECK(plusInt.AsInt(99) == 7, "+7 did not decode");
+    CHECK(plusDouble.AsDouble(99.0) == 0.5, "+.5 did not decode");
+
+    int value = 3;
+    CHECK(!nxml::ReadValue("+-5", value) && value == 3, "ReadValue accepted +-5");
+    CHECK(!nxml::ReadValue("12abc", value) && value == 3, "ReadValue accepted 12abc");
+    CHECK(nxml::ReadValue("+12", value) && value == 12, "ReadValue rejected +12");
+
+    nxml::Date date;
+    CHECK(nxml::Date::Parse("2000-02-29", date) && date.Day == 29, "2000-02-29 rejected");
+    CHECK(!nxml::Date::Parse("1900-02-29", date), "1900-02-29 accepted");
+    CHECK(!nxml::Date::Parse("2000-02-30", date), "2000-02-30 accepted");
+    CHECK(!nxml::Date::Parse("2001-04-31", date), "2001-04-31 accepted");
+    CHECK(nxml::Date::Parse("2001-12-31-14:00", date) && date.ZoneOffsetMinutes == -14 * 60, "-14:00 zone rejected");
+    CHECK(!nxml::Date::Parse("2001-12-31+14:01", date), "+14:01 zone accepted");
+    CHECK(!nxml::Date::Parse("2001-12-31+99:00", date), "+99:00 zone accepted");
+    CHECK(!nxml::Date::Parse("2001-12-31+05:60", date), "+05:60 zone accepted");
+    CHECK(nxml::Date::Parse("123456789-01-01", date) && date.Year == 123456789, "9-digit year rejected");
+    CHECK(!nxml::Date::Parse("99999999999999999999-01-01", date), "20-digit year accepted");
+}
+
+static string Decoded(string_view text)
+{
+    string out;
+    nxml::DecodeEntities(text, out);
+    return out;
+}
+
+static string Escaped(string_view text)
+{
+    string out;
+    nxml::EscapeText(text, out);
+    return out;
+}
+
+// references decode and escaping round trips the same way with the scalar and the widest supported scanners
+static void TestEntities()
+{
+    nxml::simd::Level previous = nxml::simd::GetLevel();
+    for (nxml::simd::Level level : { nxml::simd::Level::Scalar, nxml::simd::DetectLevel() })
+    {
+        nxml::simd::SetLevel(level);
+        int index = static_cast<int>(level);
+
+        CHECK(Decoded("&amp;&lt;&gt;&quot;&apos;") == "&<>\"'", "predefined entities at level " << index);
+        CHECK(Decoded("&#65;&#x42;&#x263a;") == "AB\xE2\x98\xBA", "decimal and hex references at level " << index);
+        CHECK(Decoded("&#X41;") == "&#X41;", "&#X was decoded at level " << index);
+        CHECK(Decoded("a &amp b") == "a &amp b", "reference without ';' was decoded at level " << index);
+        CHECK(Decoded("a &amp b;") == "a &amp b;", "reference split by a space was decoded at level " << index);
+        CHECK(Escaped("a&b<c>\"d'") == "a&amp;b&lt;c&gt;&quot;d'", "escaped text at level " << index);
+
+        // specials on both sides of the 16, 32 and 64 byte blocks the vector scanners work in
+        string text;
+        for (size_t i = 0; i < 200; i++)
+        {
+            text += (i % 15 == 0 || i % 16 == 15) ? "&<>\""[i % 4] : static_cast<char>('a' + i % 26);
+        }
+        CHECK(Decoded(Escaped(text)) == text, "escape round trip at level " << index);
+        CHECK(Escaped(text).find_first_of("<>\"") == string::npos, "escaped text keeps a special at level " << index);
+    }
+    nxml::simd::SetLevel(previous);
+}
+
+template <typename Node>
+static string JoinValues(const vector<Node>& nodes, string_view (*value)(const Node&))
+{
+    string joined;
+    for (const Node& node : nodes)
+    {
+        if (!joined.empty()) joined += ' ';
+        joined += value(node);
+    }
+    return joined;
+}
+
+// descendant steps from nested context nodes must report each match once, in document order
+static void TestQueryOrder()
+{
+    string xml = "<r><a><a><b>1</b><c>x</c></a><b>2</b><a><b>3</b></a></a><b>4</b><a><b>5</b></a></r>";
+    nxml::Document doc = nxml::ParseString(xml);
+    nxml::DocumentView view = nxml::ParseView(string_view(xml));
+
+    auto elementValue = [](nxml::Element* const& element) { return string_view(element->InnerValue); };
+    auto viewValue = [](const nxml::ElementView& element) { return element.InnerValue(); };
+
+    const pair<const char*, const char*> cases[] =
+    {
+        { "//a//b", "1 2 3 5" },
+        { "//a/b", "1 2 3 5" },
+        { "//b", "1 2 3 4 5" },
+        { "//a/c", "x" },
+        { "/r/*//b", "1 2 3 5" },
+        { "/r/a//b", "1 2 3 5" },
+        { "//a//b[1]", "1 2 3 5" },
+        { "//a/b[1]", "1 2 3 5" },
+    };
+    for (const auto& test : cases)
+    {
+        nxml::Query query(test.first);
+        string fromDocument = JoinValues<nxml::Element*>(query.Select(doc), elementValue);
+        string fromView = JoinValues<nxml::ElementView>(query.Select(view), viewValue);
+        CHECK(fromDocument == test.second, test.first << " on Document gave '" << fromDocument << "'");
+        CHECK(fromView == test.second, test.first << " on DocumentView gave '" << fromView << "'");
+    }
+}
+
+int main(int argc, char** argv)
+{
+    if (argc > 1) SamplePath = argv[1];
+
+    TestChunkedFeed();
+    TestParallelIdentity();
+    TestQueryOrder();
+    TestNestedParseFiles();
+    TestBinarySnapshots();
+    TestOriginalWhiteSpace();
+    TestValueDecoding();
+    TestEntities();
+#if NXML_ZLIB
+    TestTruncatedGzip();
+#endif
+
+    if (s_Failures > 0)
+    {
+        cerr << s_Failures << " check(s) failed\n";
+        return 1;
+    }
+    cout << "all checks passed\n";
+    return 0;
+}